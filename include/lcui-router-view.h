@@ -3,8 +3,44 @@
 
 #include <LCUI/gui/widget.h>
 
+typedef struct RouterViewCacheStatsRec_ {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t length;
+	size_t memory;
+} RouterViewCacheStatsRec, *RouterViewCacheStats;
+
 LCUI_Widget RouterView_GetMatchedWidget(LCUI_Widget w);
 
+void RouterView_EnablePool(const char *component_name, size_t max,
+			   LCUI_WidgetFunction reset);
+
+void RouterView_DisablePool(const char *component_name);
+
+void RouterView_ClearPools(void);
+
+void RouterView_PrefetchRoute(const router_route_t *route);
+
+void RouterView_SetPrefetchBudget(size_t concurrency, size_t max_memory);
+
+void RouterView_GetPrefetchStats(RouterViewCacheStats stats);
+
+void RouterView_SetDeferredDestroy(LCUI_BOOL enabled, long budget);
+
+size_t RouterView_FlushDestroyQueue(void);
+
+void RouterView_SetKeepAlive(LCUI_Widget w, LCUI_BOOL keep_alive);
+
+void RouterView_SetKeepAliveLimit(LCUI_Widget w, size_t max,
+				  size_t max_memory);
+
+void RouterView_GetKeepAliveStats(LCUI_Widget w, RouterViewCacheStats stats);
+
+void RouterView_SetBFCacheSize(LCUI_Widget w, size_t size);
+
+void RouterView_GetBFCacheStats(LCUI_Widget w, RouterViewCacheStats stats);
+
 void UI_InitRouterView(void);
 
 #endif
@@ -20,10 +20,45 @@ typedef struct router_history_t router_history_t;
 typedef struct router_watcher_t router_watcher_t;
 typedef struct router_matcher_t router_matcher_t;
 typedef struct router_resolved_t router_resolved_t;
+typedef struct router_navigation_t router_navigation_t;
 typedef void (*router_callback_t)(void *, const router_route_t *,
 				  const router_route_t *);
 
+typedef enum router_navigation_status_t {
+	ROUTER_NAVIGATION_DONE,
+	ROUTER_NAVIGATION_ABORTED,
+	ROUTER_NAVIGATION_CANCELLED
+} router_navigation_status_t;
+
+typedef enum router_guard_result_t {
+	ROUTER_GUARD_NEXT,
+	ROUTER_GUARD_ABORT,
+	ROUTER_GUARD_REDIRECT
+} router_guard_result_t;
+
+typedef router_guard_result_t (*router_guard_t)(void *, const router_route_t *,
+						const router_route_t *,
+						router_location_t **);
+typedef void (*router_navigation_callback_t)(void *,
+					     router_navigation_status_t);
+typedef void (*router_navigation_loader_t)(void *, router_navigation_t *);
+
+typedef struct router_match_result_t {
+	const router_route_record_t *record;
+	router_string_dict_t *params;
+} router_match_result_t;
+
+typedef struct router_pool_stats_t {
+	size_t hits;
+	size_t misses;
+	size_t length;
+	size_t capacity;
+} router_pool_stats_t;
+
 // router string dict
+//
+// Dicts can be created and destroyed on any thread, a dict itself must not
+// be used by two threads at the same time.
 
 router_string_dict_t *router_string_dict_create(void);
 
@@ -48,6 +83,8 @@ router_boolean_t router_string_dict_includes(router_string_dict_t *a,
 router_boolean_t router_string_dict_equal(router_string_dict_t *a,
 					  router_string_dict_t *b);
 
+void router_string_dict_pool_get_stats(router_pool_stats_t *stats);
+
 // router utils
 
 char *router_path_fill_params(const char *path, router_string_dict_t *params);
@@ -84,6 +121,10 @@ void router_config_set_name(router_config_t *config, const char *name);
 
 void router_config_set_path(router_config_t *config, const char *path);
 
+void router_config_set_redirect(router_config_t *config, const char *path);
+
+void router_config_add_alias(router_config_t *config, const char *path);
+
 void router_config_set_component(router_config_t *config, const char *name,
 				 const char *component);
 
@@ -117,6 +158,8 @@ const char *router_location_get_path(const router_location_t *location);
 
 char *router_location_stringify(const router_location_t *location);
 
+void router_location_pool_get_stats(router_pool_stats_t *stats);
+
 // router route record
 
 router_route_record_t *router_route_record_create(void);
@@ -126,19 +169,40 @@ void router_route_record_destroy(router_route_record_t *record);
 void router_route_record_set_path(router_route_record_t *record,
 				  const char *path);
 
+void router_route_record_set_parent(router_route_record_t *record,
+				    const router_route_record_t *parent);
+
 const char *router_route_record_get_component(
     const router_route_record_t *record, const char *key);
 
+void router_route_record_before_enter(router_route_record_t *record,
+				      router_guard_t guard, void *data);
+
+void router_route_record_before_leave(router_route_record_t *record,
+				      router_guard_t guard, void *data);
+
 // router route
+//
+// A route is shared by reference counting and builds its full path on the
+// first router_route_get_full_path() call, neither is synchronized, so a
+// route must only be used on the thread that owns the router. The query is
+// decoded when the location is normalized, only the full path is lazy.
 
 router_route_t *router_route_create(const router_route_record_t *record,
 				    const router_location_t *location);
 
 void router_route_destroy(router_route_t *route);
 
+router_route_t *router_route_ref(const router_route_t *route);
+
+void router_route_unref(router_route_t *route);
+
 const router_route_record_t *router_route_get_matched_record(
     const router_route_t *route, size_t index);
 
+size_t router_route_get_diverged_depth(const router_route_t *a,
+				       const router_route_t *b);
+
 const char *router_route_get_full_path(const router_route_t *route);
 
 const char *router_route_get_path(const router_route_t *route);
@@ -151,6 +215,8 @@ const char *router_route_get_param(const router_route_t *route,
 const char *router_route_get_query(const router_route_t *route,
 				   const char *key);
 
+void router_route_pool_get_stats(router_pool_stats_t *stats);
+
 // router matcher
 
 router_matcher_t *router_matcher_create(void);
@@ -161,6 +227,15 @@ router_route_t *router_matcher_match(router_matcher_t *matcher,
 				     const router_location_t *raw_location,
 				     const router_route_t *current_route);
 
+const router_route_record_t *router_matcher_match_record(
+    router_matcher_t *matcher, const char *path, router_string_dict_t *params);
+
+const router_route_record_t *router_matcher_test(router_matcher_t *matcher,
+						 const char *path);
+
+size_t router_matcher_match_many(router_matcher_t *matcher, const char **paths,
+				 size_t count, router_match_result_t *results);
+
 router_route_record_t *router_matcher_add_route_record(
     router_matcher_t *matcher, const router_config_t *config,
     const router_route_record_t *parent);
@@ -174,19 +249,50 @@ void router_history_destroy(router_history_t *history);
 router_watcher_t *router_history_watch(router_history_t *history,
 				       router_callback_t callback, void *data);
 
+router_watcher_t *router_history_watch_path(router_history_t *history,
+					    const char *path_prefix,
+					    router_callback_t callback,
+					    void *data);
+
+router_watcher_t *router_history_watch_name(router_history_t *history,
+					    const char *name,
+					    router_callback_t callback,
+					    void *data);
+
+router_watcher_t *router_history_watch_record(
+    router_history_t *history, const router_route_record_t *record,
+    router_callback_t callback, void *data);
+
 void router_history_unwatch(router_history_t *history,
 			    router_watcher_t *watcher);
 
+void router_history_begin_batch(router_history_t *history,
+				router_boolean_t collapse);
+
+void router_history_commit(router_history_t *history);
+
 void router_history_push(router_history_t *history, router_route_t *route);
 
 void router_history_replace(router_history_t *history, router_route_t *route);
 
 void router_history_go(router_history_t *history, int delta);
 
+void router_history_reload(router_history_t *history);
+
 size_t router_history_get_index(const router_history_t *history);
 
 size_t router_history_get_length(const router_history_t *history);
 
+size_t router_history_get_current_entry_id(const router_history_t *history);
+
+void router_history_set_max_materialized(router_history_t *history,
+					 size_t max);
+
+int router_history_save(router_history_t *history, FILE *fp);
+
+int router_history_restore(router_history_t *history,
+			   router_matcher_t *matcher, FILE *fp);
+
 // router
 
 router_t *router_create(const char *name);
@@ -197,6 +303,10 @@ router_route_record_t *router_add_route_record(
     router_t *router, const router_config_t *config,
     const router_route_record_t *parent);
 
+// Must be called on the UI thread, like router_resolve(), because it reads
+// the name index and the compiled redirects that router_add_route_record()
+// rewrites.
+
 router_route_t *router_match(router_t *router,
 			     const router_location_t *raw_location,
 			     const router_route_t *current_route);
@@ -204,11 +314,48 @@ router_route_t *router_match(router_t *router,
 router_route_record_t *router_get_matched_route_record(router_t *router,
 						       size_t index);
 
+// router_match_record(), router_match_many() and router_match_into() only
+// read a published snapshot of the route table, so they are the only match
+// functions that are safe to call from any thread while routes are added.
+// They do not follow redirects.
+
+const router_route_record_t *router_match_record(router_t *router,
+						 const char *path,
+						 router_string_dict_t *params);
+
+// Large batches are split across worker threads that live as long as the
+// router. The params of a result may be filled on a worker thread, so each
+// result needs its own dict or NULL, and the dicts must not be used by other
+// threads until the call returns.
+
+size_t router_match_many(router_t *router, const char **paths, size_t count,
+			 router_match_result_t *results);
+
+// Matches without creating a route, the query and hash are cut off in the
+// caller's scratch buffer. Nothing is allocated when out->params is NULL,
+// otherwise the dict is cleared and each captured param is copied into it.
+
+const router_route_record_t *router_match_into(router_t *router,
+					       const char *full_path,
+					       router_match_result_t *out,
+					       char *scratch,
+					       size_t scratch_size);
+
 router_history_t *router_get_history(router_t *router);
 
 router_watcher_t *router_watch(router_t *router, router_callback_t callback,
 			       void *data);
 
+router_watcher_t *router_watch_path(router_t *router, const char *path_prefix,
+				    router_callback_t callback, void *data);
+
+router_watcher_t *router_watch_name(router_t *router, const char *name,
+				    router_callback_t callback, void *data);
+
+router_watcher_t *router_watch_record(router_t *router,
+				      const router_route_record_t *record,
+				      router_callback_t callback, void *data);
+
 void router_unwatch(router_t *router, router_watcher_t *watcher);
 
 router_resolved_t *router_resolve(router_t *router, router_location_t *location,
@@ -226,14 +373,56 @@ void router_push(router_t *router, router_location_t *location);
 
 void router_replace(router_t *router, router_location_t *location);
 
+// Moves through the history after running the leave, global and enter
+// guards like a push. A move that a guard aborts keeps the current entry.
+
 void router_go(router_t *router, int delta);
 
 void router_back(router_t *router);
 
 void router_forward(router_t *router);
 
+void router_set_same_route_reload(router_t *router, router_boolean_t enabled);
+
+void router_before_each(router_t *router, router_guard_t guard, void *data);
+
+void router_begin_batch(router_t *router, router_boolean_t collapse);
+
+void router_commit(router_t *router);
+
+size_t router_navigate(router_t *router, router_location_t *location,
+		       router_boolean_t replace,
+		       router_navigation_callback_t callback, void *data);
+
+void router_cancel_navigations(router_t *router);
+
+void router_set_navigation_loader(router_t *router,
+				  router_navigation_loader_t loader,
+				  void *data);
+
+const router_route_t *router_navigation_get_route(
+    const router_navigation_t *navigation);
+
+router_boolean_t router_navigation_is_cancelled(
+    const router_navigation_t *navigation);
+
+void router_navigation_next(router_navigation_t *navigation,
+			    router_boolean_t allow);
+
+void router_push_async(router_t *router, const char *path);
+
+void router_replace_async(router_t *router, const char *path);
+
+void router_drain_requests(router_t *router);
+
+int router_save_history(router_t *router, FILE *fp);
+
+int router_restore_history(router_t *router, FILE *fp);
+
 router_t *router_get_by_name(const char *name);
 
+void router_clear_pools(void);
+
 const char *router_get_version(void);
 
 #ifdef __cplusplus
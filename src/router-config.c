@@ -8,6 +8,8 @@ router_config_t *router_config_create(void)
 	config->components = router_string_dict_create();
 	config->name = NULL;
 	config->path = NULL;
+	config->redirect = NULL;
+	LinkedList_Init(&config->aliases);
 	return config;
 }
 
@@ -15,6 +17,8 @@ void router_config_destroy(router_config_t *config)
 {
 	router_mem_free(config->name);
 	router_mem_free(config->path);
+	router_mem_free(config->redirect);
+	LinkedList_Clear(&config->aliases, free);
 	router_string_dict_destroy(config->components);
 	config->components = NULL;
 	free(config);
@@ -44,3 +48,16 @@ void router_config_set_component(router_config_t *config, const char *name,
 	}
 	router_string_dict_set(config->components, name, component);
 }
+
+void router_config_set_redirect(router_config_t *config, const char *path)
+{
+	router_mem_free(config->redirect);
+	if (path) {
+		config->redirect = strdup(path);
+	}
+}
+
+void router_config_add_alias(router_config_t *config, const char *path)
+{
+	LinkedList_Append(&config->aliases, strdup(path));
+}
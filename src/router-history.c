@@ -1,110 +1,673 @@
 ﻿#include "router.h"
 
+static void router_watcher_destroy(void *data)
+{
+	router_watcher_t *watcher = data;
+
+	if (watcher->filter == ROUTER_WATCHER_FILTER_PATH ||
+	    watcher->filter == ROUTER_WATCHER_FILTER_NAME) {
+		free((void *)watcher->key);
+	}
+	free(watcher);
+}
+
+static void router_watcher_bucket_destroy(void *privdata, void *data)
+{
+	router_linkedlist_t *bucket = data;
+
+	LinkedList_ClearData(bucket, router_watcher_destroy);
+	free(bucket);
+}
+
+static unsigned int router_pointer_hash(const void *key)
+{
+	return Dict_GenHashFunction(&key, sizeof(key));
+}
+
+static int router_pointer_compare(void *privdata, const void *key1,
+				  const void *key2)
+{
+	return key1 == key2;
+}
+
 router_history_t *router_history_create(void)
 {
 	router_history_t *history;
 
 	history = malloc(sizeof(router_history_t));
 	history->index = 0;
+	history->entry_id = 0;
+	history->current_entry_id = 0;
+	history->max_materialized = 0;
+	history->window_begin = 0;
+	history->window_end = -1;
+	history->router = NULL;
+	history->matcher = NULL;
 	history->current = NULL;
+	history->path_watchers = NULL;
+	history->name_watchers = NULL;
+	history->record_watchers = NULL;
+	history->watcher_id = 0;
+	history->dispatch_stamp = 0;
+	history->dispatching = 0;
+	history->dispatch_buffer = NULL;
+	history->dispatch_capacity = 0;
+	history->batch_depth = 0;
+	history->batch_collapse = FALSE;
+	history->batch_pushed = FALSE;
+	history->batch_from = NULL;
+	Dict_InitStringCopyKeyType(&history->string_watchers_dict_type);
+	history->string_watchers_dict_type.valDestructor =
+	    router_watcher_bucket_destroy;
+	memset(&history->pointer_watchers_dict_type, 0, sizeof(DictType));
+	history->pointer_watchers_dict_type.hashFunction = router_pointer_hash;
+	history->pointer_watchers_dict_type.keyCompare = router_pointer_compare;
+	history->pointer_watchers_dict_type.valDestructor =
+	    router_watcher_bucket_destroy;
 	LinkedList_Init(&history->watchers);
-	LinkedList_Init(&history->routes);
+	LinkedList_Init(&history->removed_watchers);
+	LinkedList_Init(&history->entries);
 	return history;
 }
 
-static void router_history_on_destroy_route(void *data)
+static router_history_entry_t *router_history_entry_create(
+    router_history_t *history, router_route_t *route)
 {
-	router_route_destroy(data);
+	router_history_entry_t *entry;
+
+	entry = malloc(sizeof(router_history_entry_t));
+	entry->id = ++history->entry_id;
+	entry->route = route;
+	entry->full_path = NULL;
+	entry->record = NULL;
+	entry->node.data = entry;
+	entry->node.prev = NULL;
+	entry->node.next = NULL;
+	return entry;
 }
 
-void router_history_destroy(router_history_t *history)
+static void router_history_entry_destroy(void *data)
 {
-	history->index = 0;
-	history->current = NULL;
-	LinkedList_ClearData(&history->watchers, free);
-	LinkedList_Clear(&history->routes, router_history_on_destroy_route);
-	free(history);
+	router_history_entry_t *entry = data;
+
+	if (entry->route) {
+		router_route_unref(entry->route);
+	}
+	router_mem_free(entry->full_path);
+	entry->route = NULL;
+	entry->record = NULL;
+	free(entry);
 }
 
-router_watcher_t *router_history_watch(router_history_t *history,
-				       router_callback_t callback, void *data)
+// A cold entry only keeps its full path and the record it matched, which
+// is enough to rebuild the route without scanning the route table.
+
+static void router_history_entry_compact(router_history_entry_t *entry)
+{
+	router_route_t *route = entry->route;
+
+	if (!route) {
+		return;
+	}
+	entry->full_path = strdup(router_route_get_full_path(route));
+	if (route->matched_length > 0) {
+		entry->record = route->matched[route->matched_length - 1];
+	}
+	router_route_unref(route);
+	entry->route = NULL;
+}
+
+// An entry is rebuilt from the record it was compacted with when its path
+// still matches that record. An alias entry kept the target record, which
+// its path does not match, so the whole route table is matched again.
+// The rebuilt route is tagged with the current routes version, so that
+// navigations from it can still reuse its matched records.
+
+static router_route_t *router_history_entry_create_route(
+    router_history_t *history, router_history_entry_t *entry)
+{
+	router_route_t *route;
+	router_location_t *raw;
+	router_location_t *location;
+	router_string_dict_t *params;
+	const router_route_record_t *record;
+
+	raw = router_location_create(NULL, entry->full_path);
+	location = router_location_normalize(raw, NULL, FALSE);
+	record = entry->record;
+	if (record) {
+		params = router_string_dict_create();
+		if (router_matcher_match_route(record, location->path,
+					       params)) {
+			if (location->params) {
+				router_string_dict_destroy(location->params);
+			}
+			location->params = params;
+		} else {
+			router_string_dict_destroy(params);
+			record = NULL;
+		}
+	}
+	if (record) {
+		route = router_route_create_from(record, location);
+	} else if (history->matcher) {
+		route = router_matcher_match(history->matcher, raw, NULL);
+	} else {
+		route = router_route_create_from(NULL, location);
+	}
+	if (history->router) {
+		route->routes_version = history->router->routes_version;
+	}
+	router_location_destroy(location);
+	router_location_destroy(raw);
+	return route;
+}
+
+static router_route_t *router_history_entry_get_route(
+    router_history_t *history, router_history_entry_t *entry)
+{
+	if (!entry->route) {
+		entry->route =
+		    router_history_entry_create_route(history, entry);
+		router_mem_free(entry->full_path);
+	}
+	return entry->route;
+}
+
+// Entries more than `max_materialized` steps away from the current one are
+// cold. Only the entries inside the previous window can still have a route,
+// so a navigation visits them instead of the whole stack.
+
+static void router_history_compact(router_history_t *history,
+				   router_linkedlist_node_t *current)
+{
+	int i;
+	int max = (int)history->max_materialized;
+	router_linkedlist_node_t *node;
+
+	if (max < 1) {
+		return;
+	}
+	node = current->prev;
+	for (i = history->index - 1; i >= 0 && i >= history->window_begin;
+	     --i, node = node->prev) {
+		if (history->index - i >= max) {
+			router_history_entry_compact(node->data);
+		}
+	}
+	node = current->next;
+	for (i = history->index + 1; node && i <= history->window_end;
+	     ++i, node = node->next) {
+		if (i - history->index >= max) {
+			router_history_entry_compact(node->data);
+		}
+	}
+	history->window_begin = history->index - max + 1;
+	history->window_end = history->index + max - 1;
+}
+
+// Visits every entry, for when the window is unknown.
+
+static void router_history_compact_all(router_history_t *history)
+{
+	if (history->entries.length < 1) {
+		return;
+	}
+	history->window_begin = 0;
+	history->window_end = (int)history->entries.length - 1;
+	router_history_compact(
+	    history, LinkedList_GetNode(&history->entries, history->index));
+}
+
+// Buckets of filtered watchers are indexed by their key in a dict per
+// filter, created on first use. Returns NULL for unfiltered watchers.
+
+static Dict **router_history_get_watchers_dict(router_history_t *history,
+					       router_watcher_filter_t filter)
 {
+	Dict **dict;
+	DictType *type = &history->string_watchers_dict_type;
+
+	switch (filter) {
+	case ROUTER_WATCHER_FILTER_PATH:
+		dict = &history->path_watchers;
+		break;
+	case ROUTER_WATCHER_FILTER_NAME:
+		dict = &history->name_watchers;
+		break;
+	case ROUTER_WATCHER_FILTER_RECORD:
+		dict = &history->record_watchers;
+		type = &history->pointer_watchers_dict_type;
+		break;
+	default:
+		return NULL;
+	}
+	if (!*dict) {
+		*dict = Dict_Create(type, NULL);
+	}
+	return dict;
+}
+
+// Path prefixes are indexed without their trailing slash, so "/foo/" and
+// "/foo" watch the same subtree.
+
+static char *router_watcher_path_key(const char *path)
+{
+	size_t len = strlen(path);
+	char *key = strdup(path);
+
+	if (len > 1 && key[len - 1] == '/') {
+		key[len - 1] = 0;
+	}
+	return key;
+}
+
+static router_watcher_t *router_history_add_watcher(
+    router_history_t *history, router_watcher_filter_t filter,
+    const void *key, router_callback_t callback, void *data)
+{
+	Dict **dict;
 	router_watcher_t *watcher;
 
 	watcher = malloc(sizeof(router_watcher_t));
+	watcher->id = ++history->watcher_id;
+	watcher->stamp = 0;
+	watcher->filter = filter;
+	watcher->key = key;
+	watcher->removed = FALSE;
 	watcher->node.data = watcher;
 	watcher->node.next = NULL;
 	watcher->node.prev = NULL;
 	watcher->data = data;
 	watcher->callback = callback;
-	LinkedList_AppendNode(&history->watchers, &watcher->node);
+	dict = router_history_get_watchers_dict(history, filter);
+	if (!dict) {
+		watcher->bucket = &history->watchers;
+		LinkedList_AppendNode(watcher->bucket, &watcher->node);
+		return watcher;
+	}
+	watcher->bucket = Dict_FetchValue(*dict, key);
+	if (!watcher->bucket) {
+		watcher->bucket = malloc(sizeof(router_linkedlist_t));
+		LinkedList_Init(watcher->bucket);
+		Dict_Add(*dict, (void *)key, watcher->bucket);
+	}
+	LinkedList_AppendNode(watcher->bucket, &watcher->node);
 	return watcher;
 }
 
+void router_history_destroy(router_history_t *history)
+{
+	history->index = 0;
+	history->current = NULL;
+	LinkedList_ClearData(&history->watchers, router_watcher_destroy);
+	LinkedList_ClearData(&history->removed_watchers,
+			     router_watcher_destroy);
+	if (history->path_watchers) {
+		Dict_Release(history->path_watchers);
+	}
+	if (history->name_watchers) {
+		Dict_Release(history->name_watchers);
+	}
+	if (history->record_watchers) {
+		Dict_Release(history->record_watchers);
+	}
+	router_mem_free(history->dispatch_buffer);
+	if (history->batch_from) {
+		router_route_unref(history->batch_from);
+	}
+	LinkedList_ClearData(&history->entries, router_history_entry_destroy);
+	free(history);
+}
+
+router_watcher_t *router_history_watch(router_history_t *history,
+				       router_callback_t callback, void *data)
+{
+	return router_history_add_watcher(history, ROUTER_WATCHER_FILTER_NONE,
+					  NULL, callback, data);
+}
+
+// Filtered watchers are only called when the route navigated from or to
+// is inside the path prefix, has the name or has matched the record.
+
+router_watcher_t *router_history_watch_path(router_history_t *history,
+					    const char *path_prefix,
+					    router_callback_t callback,
+					    void *data)
+{
+	return router_history_add_watcher(
+	    history, ROUTER_WATCHER_FILTER_PATH,
+	    router_watcher_path_key(path_prefix), callback, data);
+}
+
+router_watcher_t *router_history_watch_name(router_history_t *history,
+					    const char *name,
+					    router_callback_t callback,
+					    void *data)
+{
+	return router_history_add_watcher(history, ROUTER_WATCHER_FILTER_NAME,
+					  strdup(name), callback, data);
+}
+
+router_watcher_t *router_history_watch_record(
+    router_history_t *history, const router_route_record_t *record,
+    router_callback_t callback, void *data)
+{
+	return router_history_add_watcher(
+	    history, ROUTER_WATCHER_FILTER_RECORD, record, callback, data);
+}
+
+// A watcher removed while watchers are being called is only freed after
+// the dispatch has finished.
+
 void router_history_unwatch(router_history_t *history,
 			    router_watcher_t *watcher)
 {
-	LinkedList_Unlink(&history->watchers, &watcher->node);
-	free(watcher);
+	Dict **dict;
+
+	LinkedList_Unlink(watcher->bucket, &watcher->node);
+	dict = router_history_get_watchers_dict(history, watcher->filter);
+	if (dict && watcher->bucket->length < 1) {
+		Dict_Delete(*dict, watcher->key);
+	}
+	if (history->dispatching > 0) {
+		watcher->removed = TRUE;
+		watcher->bucket = &history->removed_watchers;
+		LinkedList_AppendNode(watcher->bucket, &watcher->node);
+		return;
+	}
+	router_watcher_destroy(watcher);
 }
 
-static void router_history_change(router_history_t *history, router_route_t *to)
+typedef struct router_watcher_set_t {
+	size_t length;
+	size_t capacity;
+	router_watcher_t **watchers;
+	router_boolean_t sorted;
+} router_watcher_set_t;
+
+static void router_watcher_set_add_bucket(router_history_t *history,
+					  router_watcher_set_t *set,
+					  router_linkedlist_t *bucket)
 {
 	router_watcher_t *watcher;
 	router_linkedlist_node_t *node;
 
-	for (LinkedList_Each(node, &history->watchers)) {
+	if (!bucket) {
+		return;
+	}
+	for (LinkedList_Each(node, bucket)) {
 		watcher = node->data;
-		watcher->callback(watcher->data, to, history->current);
+		if (watcher->stamp == history->dispatch_stamp) {
+			continue;
+		}
+		watcher->stamp = history->dispatch_stamp;
+		if (set->length >= set->capacity) {
+			set->capacity = set->capacity > 0 ? set->capacity * 2 : 16;
+			set->watchers =
+			    realloc(set->watchers,
+				    sizeof(router_watcher_t *) * set->capacity);
+		}
+		if (set->length > 0 &&
+		    set->watchers[set->length - 1]->id > watcher->id) {
+			set->sorted = FALSE;
+		}
+		set->watchers[set->length++] = watcher;
+	}
+}
+
+static void router_watcher_set_add_route(router_history_t *history,
+					 router_watcher_set_t *set,
+					 const router_route_t *route)
+{
+	size_t i;
+	char *path;
+	char c;
+
+	if (!route) {
+		return;
+	}
+	if (history->record_watchers) {
+		for (i = 0; i < route->matched_length; ++i) {
+			router_watcher_set_add_bucket(
+			    history, set,
+			    Dict_FetchValue(history->record_watchers,
+					    route->matched[i]));
+		}
+	}
+	if (history->name_watchers && route->name) {
+		router_watcher_set_add_bucket(
+		    history, set,
+		    Dict_FetchValue(history->name_watchers, route->name));
+	}
+	if (!history->path_watchers || !route->path) {
+		return;
+	}
+	router_watcher_set_add_bucket(
+	    history, set, Dict_FetchValue(history->path_watchers, "/"));
+	path = strdup(route->path);
+	for (i = 1; path[0] == '/' && path[i - 1]; ++i) {
+		if (path[i] != '/' && path[i] != 0) {
+			continue;
+		}
+		c = path[i];
+		path[i] = 0;
+		router_watcher_set_add_bucket(
+		    history, set, Dict_FetchValue(history->path_watchers, path));
+		path[i] = c;
+	}
+	free(path);
+}
+
+static int router_watcher_compare(const void *a, const void *b)
+{
+	const router_watcher_t *x = *(router_watcher_t *const *)a;
+	const router_watcher_t *y = *(router_watcher_t *const *)b;
+
+	return x->id < y->id ? -1 : (x->id > y->id ? 1 : 0);
+}
+
+// Interested watchers are collected first and called in the order they
+// were registered in, whichever index they were found through.
+
+static void router_history_dispatch(router_history_t *history,
+				    router_route_t *to)
+{
+	size_t i;
+	router_watcher_t *watcher;
+	router_watcher_set_t set = { 0 };
+
+	set.sorted = TRUE;
+	if (history->dispatching < 1) {
+		set.watchers = history->dispatch_buffer;
+		set.capacity = history->dispatch_capacity;
+	}
+	history->dispatch_stamp++;
+	router_watcher_set_add_bucket(history, &set, &history->watchers);
+	router_watcher_set_add_route(history, &set, to);
+	router_watcher_set_add_route(history, &set, history->current);
+	if (!set.sorted) {
+		qsort(set.watchers, set.length, sizeof(router_watcher_t *),
+		      router_watcher_compare);
+	}
+	history->dispatching++;
+	for (i = 0; i < set.length; ++i) {
+		watcher = set.watchers[i];
+		if (!watcher->removed) {
+			watcher->callback(watcher->data, to, history->current);
+		}
+	}
+	history->dispatching--;
+	if (history->dispatching < 1) {
+		history->dispatch_buffer = set.watchers;
+		history->dispatch_capacity = set.capacity;
+		LinkedList_ClearData(&history->removed_watchers,
+				     router_watcher_destroy);
+	} else {
+		free(set.watchers);
 	}
 	history->current = to;
 }
 
+// Inside a batch the current route changes silently, watchers are only
+// told about the final route when the batch is committed.
+
+static void router_history_change(router_history_t *history, router_route_t *to)
+{
+	if (history->batch_depth > 0) {
+		history->current = to;
+		return;
+	}
+	router_history_dispatch(history, to);
+}
+
+// Notifies the watchers with the current route as both the target and the
+// source, without touching the history entries.
+
+void router_history_reload(router_history_t *history)
+{
+	if (history->current && history->batch_depth < 1) {
+		router_history_dispatch(history, history->current);
+	}
+}
+
+void router_history_begin_batch(router_history_t *history,
+				router_boolean_t collapse)
+{
+	if (history->batch_depth++ > 0) {
+		history->batch_collapse = history->batch_collapse && collapse;
+		return;
+	}
+	history->batch_collapse = collapse;
+	history->batch_pushed = FALSE;
+	if (history->current) {
+		history->batch_from = router_route_ref(history->current);
+	}
+}
+
+void router_history_commit(router_history_t *history)
+{
+	router_route_t *to = history->current;
+	router_route_t *from = history->batch_from;
+
+	if (history->batch_depth < 1 || --history->batch_depth > 0) {
+		return;
+	}
+	history->batch_from = NULL;
+	if (to != from) {
+		history->current = from;
+		router_history_dispatch(history, to);
+	}
+	if (from) {
+		router_route_unref(from);
+	}
+}
+
 void router_history_push(router_history_t *history, router_route_t *route)
 {
 	int index = 0;
+	router_history_entry_t *entry;
 	router_linkedlist_node_t *next;
 	router_linkedlist_node_t *node = NULL;
 
-	for (LinkedList_Each(node, &history->routes)) {
+	if (history->batch_depth > 0 && history->batch_collapse) {
+		if (history->batch_pushed) {
+			router_history_replace(history, route);
+			return;
+		}
+		history->batch_pushed = TRUE;
+	}
+	for (LinkedList_Each(node, &history->entries)) {
 		if (index <= history->index) {
 			index++;
 			continue;
 		}
 		while (node) {
 			next = node->next;
-			router_route_destroy(node->data);
-			LinkedList_DeleteNode(&history->routes, node);
+			LinkedList_Unlink(&history->entries, node);
+			router_history_entry_destroy(node->data);
 			node = next;
 		}
 		break;
 	}
+	entry = router_history_entry_create(history, route);
+	history->current_entry_id = entry->id;
 	router_history_change(history, route);
-	LinkedList_Append(&history->routes, route);
-	history->index = (int)history->routes.length - 1;
+	LinkedList_AppendNode(&history->entries, &entry->node);
+	history->index = (int)history->entries.length - 1;
+	router_history_compact(history, &entry->node);
 }
 
 void router_history_replace(router_history_t *history, router_route_t *route)
 {
+	router_history_entry_t *entry;
 	router_linkedlist_node_t *node;
 
-	node = LinkedList_GetNode(&history->routes, history->index);
+	node = LinkedList_GetNode(&history->entries, history->index);
+	entry = node->data;
+	entry->id = ++history->entry_id;
+	history->current_entry_id = entry->id;
 	router_history_change(history, route);
-	router_route_destroy(node->data);
-	LinkedList_Insert(&history->routes, history->index, route);
-	LinkedList_DeleteNode(&history->routes, node);
+	if (entry->route) {
+		router_route_unref(entry->route);
+	}
+	router_mem_free(entry->full_path);
+	entry->route = route;
+	entry->record = NULL;
+}
+
+static int router_history_get_target_index(router_history_t *history,
+					   int delta)
+{
+	int index = history->index + delta;
+
+	if (index < 0) {
+		return 0;
+	}
+	if ((size_t)index >= history->entries.length) {
+		return (int)history->entries.length - 1;
+	}
+	return index;
+}
+
+// Returns a new reference to the route `delta` steps away from the current
+// entry without moving to it, or NULL when that is the current entry. A
+// compacted entry stays compacted, its route is rebuilt for the caller.
+
+router_route_t *router_history_peek(router_history_t *history, int delta)
+{
+	int index;
+	router_history_entry_t *entry;
+
+	if (history->entries.length < 1) {
+		return NULL;
+	}
+	index = router_history_get_target_index(history, delta);
+	if (index == history->index) {
+		return NULL;
+	}
+	entry = LinkedList_Get(&history->entries, index);
+	if (entry->route) {
+		return router_route_ref(entry->route);
+	}
+	return router_history_entry_create_route(history, entry);
 }
 
 void router_history_go(router_history_t *history, int delta)
 {
-	history->index += delta;
-	if (history->index < 0) {
-		history->index = 0;
-	} else if ((size_t)history->index >= history->routes.length) {
-		history->index = (int)history->routes.length - 1;
+	router_history_entry_t *entry;
+	router_linkedlist_node_t *node;
+
+	if (history->entries.length < 1) {
+		return;
 	}
+	history->index = router_history_get_target_index(history, delta);
+	node = LinkedList_GetNode(&history->entries, history->index);
+	entry = node->data;
+	history->current_entry_id = entry->id;
 	router_history_change(history,
-			      LinkedList_Get(&history->routes, history->index));
+			      router_history_entry_get_route(history, entry));
+	router_history_compact(history, node);
 }
 
 size_t router_history_get_index(const router_history_t *history)
@@ -114,5 +677,207 @@ size_t router_history_get_index(const router_history_t *history)
 
 size_t router_history_get_length(const router_history_t *history)
 {
-	return history->routes.length;
+	return history->entries.length;
+}
+
+// Entry ids are never reused, a replaced entry gets a new one.
+
+size_t router_history_get_current_entry_id(const router_history_t *history)
+{
+	return history->current_entry_id;
+}
+
+// Only entries less than `max` steps away from the current one keep their
+// route, the others are reduced to their full path and matched record and
+// are rebuilt when navigated to. Zero keeps every entry materialized.
+
+void router_history_set_max_materialized(router_history_t *history,
+					 size_t max)
+{
+	history->max_materialized = max;
+	router_history_compact_all(history);
+}
+
+// History file format:
+//
+//   lcui-router-history <version>
+//   <length> <index>
+//   <full path of entry 0>
+//   ...
+//   <full path of entry length - 1>
+//
+// Since version 2, '%', CR and LF in a full path are percent-encoded so
+// that every entry stays on its own line.
+
+static int router_history_write_path(FILE *fp, const char *path)
+{
+	for (; *path; ++path) {
+		if (*path == '%' || *path == '\r' || *path == '\n') {
+			if (fprintf(fp, "%%%02X", (unsigned char)*path) < 0) {
+				return -1;
+			}
+		} else if (fputc(*path, fp) == EOF) {
+			return -1;
+		}
+	}
+	return fputc('\n', fp) == EOF ? -1 : 0;
+}
+
+int router_history_save(router_history_t *history, FILE *fp)
+{
+	const char *full_path;
+	router_history_entry_t *entry;
+	router_linkedlist_node_t *node;
+
+	if (fprintf(fp, "%s %d\n%zu %d\n", ROUTER_HISTORY_FILE_MAGIC,
+		    ROUTER_HISTORY_FILE_VERSION, history->entries.length,
+		    history->index) < 0) {
+		return -1;
+	}
+	for (LinkedList_Each(node, &history->entries)) {
+		entry = node->data;
+		if (entry->route) {
+			full_path = router_route_get_full_path(entry->route);
+		} else {
+			full_path = entry->full_path;
+		}
+		if (router_history_write_path(fp, full_path) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int router_history_hex_value(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static void router_history_decode_path(char *path)
+{
+	int high, low;
+	char *p = path;
+
+	for (; *path; ++path, ++p) {
+		if (*path == '%' &&
+		    (high = router_history_hex_value(path[1])) >= 0 &&
+		    (low = router_history_hex_value(path[2])) >= 0) {
+			*p = (char)(high * 16 + low);
+			path += 2;
+		} else {
+			*p = *path;
+		}
+	}
+	*p = 0;
+}
+
+static char *router_history_read_line(FILE *fp)
+{
+	char *line = NULL;
+	size_t len = 0;
+	size_t size = 0;
+
+	while (1) {
+		if (len + 1 >= size) {
+			size = size > 0 ? size * 2 : 128;
+			line = realloc(line, sizeof(char) * size);
+		}
+		if (!fgets(line + len, (int)(size - len), fp)) {
+			break;
+		}
+		len += strlen(line + len);
+		if (len > 0 && line[len - 1] == '\n') {
+			line[--len] = 0;
+			return line;
+		}
+	}
+	if (len > 0) {
+		return line;
+	}
+	free(line);
+	return NULL;
+}
+
+static void router_history_move_entries(router_linkedlist_t *dst,
+					router_linkedlist_t *src)
+{
+	router_linkedlist_node_t *node;
+
+	while (src->length > 0) {
+		node = src->head.next;
+		LinkedList_Unlink(src, node);
+		LinkedList_AppendNode(dst, node);
+	}
+}
+
+// Entries are restored cold and only the current one is rebuilt, the
+// watchers are notified once after the restored stack is in place.
+
+int router_history_restore(router_history_t *history,
+			   router_matcher_t *matcher, FILE *fp)
+{
+	int index;
+	int version;
+	char c;
+	char *line;
+	char magic[32];
+	size_t i, length, path_len;
+	router_route_t *route;
+	router_linkedlist_t entries;
+	router_linkedlist_t old_entries;
+	router_history_entry_t *entry;
+
+	if (fscanf(fp, "%31s %d %zu %d", magic, &version, &length, &index) !=
+		4 ||
+	    fgetc(fp) != '\n') {
+		return -1;
+	}
+	if (strcmp(magic, ROUTER_HISTORY_FILE_MAGIC) != 0 ||
+	    version < 1 || version > ROUTER_HISTORY_FILE_VERSION ||
+	    index < 0 || (size_t)index >= length) {
+		return -1;
+	}
+	LinkedList_Init(&entries);
+	for (i = 0; i < length; ++i) {
+		line = router_history_read_line(fp);
+		if (!line) {
+			break;
+		}
+		if (version > 1) {
+			router_history_decode_path(line);
+		}
+		entry = router_history_entry_create(history, NULL);
+		entry->full_path = line;
+		path_len = strcspn(line, "?#");
+		c = line[path_len];
+		line[path_len] = 0;
+		entry->record = router_matcher_test(matcher, line);
+		line[path_len] = c;
+		LinkedList_AppendNode(&entries, &entry->node);
+	}
+	if (i < length) {
+		LinkedList_ClearData(&entries, router_history_entry_destroy);
+		return -1;
+	}
+	history->matcher = matcher;
+	entry = LinkedList_Get(&entries, index);
+	route = router_history_entry_get_route(history, entry);
+	LinkedList_Init(&old_entries);
+	router_history_move_entries(&old_entries, &history->entries);
+	router_history_move_entries(&history->entries, &entries);
+	history->index = index;
+	history->current_entry_id = entry->id;
+	router_history_change(history, route);
+	LinkedList_ClearData(&old_entries, router_history_entry_destroy);
+	router_history_compact_all(history);
+	return 0;
 }
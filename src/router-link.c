@@ -1,52 +1,537 @@
 ﻿#include "router.h"
 #include "lcui-router-link.h"
+#include "lcui-router-view.h"
+#include <LCUI/timer.h>
 
 // Refer: https://router.vuejs.org/api/#router-link-props
 
+#ifndef ROUTER_LINK_IDLE_DELAY
+#define ROUTER_LINK_IDLE_DELAY 300
+#endif
+
+#define ROUTER_LINK_IDLE_INTERVAL 16
+
+typedef enum RouterLinkPrefetchMode_ {
+	ROUTER_LINK_PREFETCH_NONE,
+	ROUTER_LINK_PREFETCH_HOVER,
+	ROUTER_LINK_PREFETCH_IDLE
+} RouterLinkPrefetchMode;
+
+// What a target resolved against the current route has to be resolved
+// again for when the current route changes.
+
+typedef enum RouterLinkDependency_ {
+	ROUTER_LINK_DEPENDS_NONE,
+	ROUTER_LINK_DEPENDS_PATH,
+	ROUTER_LINK_DEPENDS_PARAMS,
+	ROUTER_LINK_DEPENDS_ROUTE
+} RouterLinkDependency;
+
+typedef struct RouterLinkTrieNodeRec_ {
+	Dict *children;
+	LinkedList links;
+} RouterLinkTrieNodeRec, *RouterLinkTrieNode;
+
+// Links of a router are indexed by their target path, so a navigation
+// only has to visit the links that may be active for the new route and
+// the ones that were active for the old one. Links whose target depends
+// on the current route are kept apart and checked on every navigation.
+// The other links are indexed by the path their target resolved to, so
+// they are indexed again when the route table changes.
+
+typedef struct RouterLinkIndexRec_ {
+	size_t length;
+	size_t stamp;
+	size_t routes_version;
+	router_t *router;
+	router_watcher_t *watcher;
+	Dict *exact_links;
+	DictType exact_links_dict_type;
+	RouterLinkTrieNodeRec trie;
+	LinkedList links;
+	LinkedList dynamic_links;
+	LinkedList active_links;
+	LinkedListNode node;
+} RouterLinkIndexRec, *RouterLinkIndex;
+
 typedef struct RouterLinkRec_ {
 	char *active_class;
 	char *exact_active_class;
 	router_boolean_t exact;
 	router_boolean_t replace;
+	router_boolean_t active;
+	router_boolean_t exact_active;
+	RouterLinkPrefetchMode prefetch;
 	router_t *router;
 	router_location_t *to;
 	router_route_record_t *record;
-	router_watcher_t *watcher;
+	RouterLinkDependency depends;
+	size_t routes_version;
+	router_route_t *resolved;
+	router_route_t *resolved_base;
+	size_t stamp;
+	LCUI_Widget widget;
+	RouterLinkIndex index;
+	LinkedList *bucket;
+	LinkedListNode node;
+	LinkedListNode index_node;
+	LinkedListNode active_node;
+	LinkedListNode idle_node;
 } RouterLinkRec, *RouterLink;
 
+// Links with prefetch="idle" wait here until no navigation has happened
+// and no link has become ready for ROUTER_LINK_IDLE_DELAY milliseconds.
+
+typedef struct RouterLinkIdleQueueRec_ {
+	int timer;
+	int64_t active_time;
+	LinkedList links;
+} RouterLinkIdleQueueRec;
+
 static LCUI_WidgetPrototype router_link_proto;
+static DictType router_link_trie_dict_type;
+static LinkedList router_link_indexes;
+static RouterLinkIdleQueueRec router_link_idle_queue;
 
-static void RouterLink_OnRouteUpdate(void *w, const router_route_t *to,
-				     const router_route_t *from)
+static RouterLinkDependency RouterLink_GetDependency(
+    const router_location_t *to)
 {
-	RouterLink link;
-	router_route_t *route;
+	if (to->name) {
+		return ROUTER_LINK_DEPENDS_PARAMS;
+	}
+	if (to->normalized) {
+		return ROUTER_LINK_DEPENDS_NONE;
+	}
+	if (!to->path) {
+		return to->params ? ROUTER_LINK_DEPENDS_ROUTE
+				  : ROUTER_LINK_DEPENDS_PATH;
+	}
+	if (to->path[0] == '/') {
+		return ROUTER_LINK_DEPENDS_NONE;
+	}
+	return ROUTER_LINK_DEPENDS_PATH;
+}
+
+static void RouterLink_ClearResolvedRoute(RouterLink link)
+{
+	if (link->resolved) {
+		router_route_unref(link->resolved);
+	}
+	if (link->resolved_base) {
+		router_route_unref(link->resolved_base);
+	}
+	link->resolved = NULL;
+	link->resolved_base = NULL;
+}
+
+static router_boolean_t RouterLink_IsResolvedRouteValid(
+    RouterLink link, const router_route_t *current)
+{
+	const router_route_t *base = link->resolved_base;
+
+	if (!link->resolved ||
+	    link->routes_version != link->router->routes_version) {
+		return FALSE;
+	}
+	if (link->depends == ROUTER_LINK_DEPENDS_NONE) {
+		return TRUE;
+	}
+	if (!base || !current) {
+		return base == current;
+	}
+	switch (link->depends) {
+	case ROUTER_LINK_DEPENDS_PATH:
+		return router_string_compare(base->path, current->path) == 0;
+	case ROUTER_LINK_DEPENDS_PARAMS:
+		return router_string_dict_equal(base->params, current->params);
+	default:
+		break;
+	}
+	return strcmp(router_route_get_full_path(base),
+		      router_route_get_full_path(current)) == 0;
+}
+
+// The target route is resolved once and reused until the location, the
+// route table or the part of the current route it depends on changes.
+
+static const router_route_t *RouterLink_GetResolvedRoute(RouterLink link)
+{
+	const router_route_t *current;
 	router_resolved_t *resolved;
-	router_boolean_t is_same_route;
 
-	link = Widget_GetData(w, router_link_proto);
+	current = router_get_current_route(link->router);
+	if (RouterLink_IsResolvedRouteValid(link, current)) {
+		return link->resolved;
+	}
+	RouterLink_ClearResolvedRoute(link);
 	resolved = router_resolve(link->router, link->to, FALSE);
-	route = router_resolved_get_route(resolved);
+	link->resolved = resolved->route;
+	link->routes_version = link->router->routes_version;
+	if (current && link->depends != ROUTER_LINK_DEPENDS_NONE) {
+		link->resolved_base = router_route_ref(current);
+	}
+	resolved->route = NULL;
+	router_resolved_destroy(resolved);
+	return link->resolved;
+}
+
+static void RouterLink_SetActive(RouterLink link, router_boolean_t active,
+				 router_boolean_t exact_active)
+{
+	router_boolean_t was_active = link->active || link->exact_active;
+
+	if (link->exact_active != exact_active) {
+		if (exact_active) {
+			Widget_AddClass(link->widget, link->exact_active_class);
+		} else {
+			Widget_RemoveClass(link->widget,
+					   link->exact_active_class);
+		}
+		link->exact_active = exact_active;
+	}
+	if (link->active != active) {
+		if (active) {
+			Widget_AddClass(link->widget, link->active_class);
+		} else {
+			Widget_RemoveClass(link->widget, link->active_class);
+		}
+		link->active = active;
+	}
+	if (!link->index || was_active == (active || exact_active)) {
+		return;
+	}
+	if (was_active) {
+		LinkedList_Unlink(&link->index->active_links,
+				  &link->active_node);
+	} else {
+		LinkedList_AppendNode(&link->index->active_links,
+				      &link->active_node);
+	}
+}
+
+static void RouterLink_Update(RouterLink link, const router_route_t *to)
+{
+	const router_route_t *route;
+	router_boolean_t is_same_route;
+
+	if (link->index) {
+		link->stamp = link->index->stamp;
+	}
+	if (!to || !link->to) {
+		RouterLink_SetActive(link, FALSE, FALSE);
+		return;
+	}
+	route = RouterLink_GetResolvedRoute(link);
 	// https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/src/components/link.js#L65
 	is_same_route = router_is_same_route(to, route);
-	if (is_same_route) {
-		Widget_AddClass(w, link->exact_active_class);
+	if (link->exact) {
+		RouterLink_SetActive(link, is_same_route, is_same_route);
 	} else {
-		Widget_RemoveClass(w, link->exact_active_class);
+		RouterLink_SetActive(link, router_is_included_route(to, route),
+				     is_same_route);
+	}
+}
+
+static void RouterLink_UpdateList(LinkedList *links, const router_route_t *to)
+{
+	LinkedListNode *node;
+
+	for (LinkedList_Each(node, links)) {
+		RouterLink_Update(node->data, to);
+	}
+}
+
+static RouterLinkTrieNode RouterLinkTrieNode_Create(void)
+{
+	RouterLinkTrieNode node;
+
+	node = malloc(sizeof(RouterLinkTrieNodeRec));
+	node->children = NULL;
+	LinkedList_Init(&node->links);
+	return node;
+}
+
+static void RouterLinkTrieNode_Destroy(void *privdata, void *data)
+{
+	RouterLinkTrieNode node = data;
+
+	if (node->children) {
+		Dict_Release(node->children);
+	}
+	free(node);
+}
+
+static RouterLinkTrieNode RouterLinkTrieNode_GetChild(RouterLinkTrieNode node,
+						      const char *name,
+						      router_boolean_t create)
+{
+	RouterLinkTrieNode child = NULL;
+
+	if (node->children) {
+		child = Dict_FetchValue(node->children, name);
+	}
+	if (child || !create) {
+		return child;
 	}
-	do {
-		if (link->exact) {
-			if (is_same_route) {
-				Widget_AddClass(w, link->active_class);
-				break;
+	if (!node->children) {
+		node->children = Dict_Create(&router_link_trie_dict_type, NULL);
+	}
+	child = RouterLinkTrieNode_Create();
+	Dict_Add(node->children, (void *)name, child);
+	return child;
+}
+
+static char *RouterLink_NextSegment(char **str)
+{
+	char *p = *str;
+	char *segment;
+
+	while (*p == '/') {
+		p++;
+	}
+	if (!*p) {
+		return NULL;
+	}
+	segment = p;
+	while (*p && *p != '/') {
+		p++;
+	}
+	if (*p) {
+		*p++ = 0;
+	}
+	*str = p;
+	return segment;
+}
+
+// The exact bucket key of a path ignores its trailing slash, the same way
+// router_path_compare() does.
+
+static char *RouterLinkIndex_GetPathKey(const char *path)
+{
+	size_t len = strlen(path);
+	char *key = strdup(path);
+
+	if (len > 1 && key[len - 1] == '/') {
+		key[len - 1] = 0;
+	}
+	return key;
+}
+
+static void RouterLinkIndex_Unlink(RouterLink link);
+
+static void RouterLinkIndex_Link(RouterLink link);
+
+// A redirect or an alias added later can change the path a target
+// resolves to, so links indexed by their path are moved to their new
+// bucket before the index is used.
+
+static void RouterLinkIndex_Refresh(RouterLinkIndex index)
+{
+	RouterLink link;
+	LinkedListNode *node;
+
+	if (index->routes_version == index->router->routes_version) {
+		return;
+	}
+	index->routes_version = index->router->routes_version;
+	for (LinkedList_Each(node, &index->links)) {
+		link = node->data;
+		if (link->to && link->depends == ROUTER_LINK_DEPENDS_NONE) {
+			RouterLinkIndex_Unlink(link);
+			RouterLinkIndex_Link(link);
+		}
+	}
+}
+
+static void RouterLinkIndex_OnRouteUpdate(void *arg, const router_route_t *to,
+					  const router_route_t *from)
+{
+	char *key;
+	char *path;
+	char *p;
+	char *segment;
+	LinkedList *links;
+	LinkedListNode *node;
+	LinkedListNode *next;
+	RouterLinkIndex index = arg;
+	RouterLinkTrieNode trie = &index->trie;
+
+	router_link_idle_queue.active_time = LCUI_GetTime();
+	index->stamp++;
+	RouterLinkIndex_Refresh(index);
+	if (to && to->path) {
+		key = RouterLinkIndex_GetPathKey(to->path);
+		links = Dict_FetchValue(index->exact_links, key);
+		if (links) {
+			RouterLink_UpdateList(links, to);
+		}
+		free(key);
+		path = strdup(to->path);
+		p = path;
+		RouterLink_UpdateList(&trie->links, to);
+		while (trie && (segment = RouterLink_NextSegment(&p))) {
+			trie = RouterLinkTrieNode_GetChild(trie, segment, FALSE);
+			if (trie) {
+				RouterLink_UpdateList(&trie->links, to);
 			}
-		} else if (router_is_included_route(to, route)) {
-			Widget_AddClass(w, link->active_class);
-			break;
 		}
-		Widget_RemoveClass(w, link->active_class);
-	} while (0);
-	router_resolved_destroy(resolved);
+		free(path);
+	}
+	RouterLink_UpdateList(&index->dynamic_links, to);
+	for (node = index->active_links.head.next; node; node = next) {
+		next = node->next;
+		if (((RouterLink)node->data)->stamp != index->stamp) {
+			RouterLink_Update(node->data, to);
+		}
+	}
+}
+
+static void RouterLinkIndex_DestroyBucket(void *privdata, void *data)
+{
+	free(data);
+}
+
+static RouterLinkIndex RouterLinkIndex_Get(router_t *router)
+{
+	LinkedListNode *node;
+	RouterLinkIndex index;
+
+	for (LinkedList_Each(node, &router_link_indexes)) {
+		index = node->data;
+		if (index->router == router) {
+			return index;
+		}
+	}
+	index = malloc(sizeof(RouterLinkIndexRec));
+	index->length = 0;
+	index->stamp = 0;
+	index->routes_version = router->routes_version;
+	index->router = router;
+	Dict_InitStringCopyKeyType(&index->exact_links_dict_type);
+	index->exact_links_dict_type.valDestructor =
+	    RouterLinkIndex_DestroyBucket;
+	index->exact_links = Dict_Create(&index->exact_links_dict_type, NULL);
+	index->trie.children = NULL;
+	LinkedList_Init(&index->trie.links);
+	LinkedList_Init(&index->links);
+	LinkedList_Init(&index->dynamic_links);
+	LinkedList_Init(&index->active_links);
+	index->node.data = index;
+	LinkedList_AppendNode(&router_link_indexes, &index->node);
+	index->watcher =
+	    router_watch(router, RouterLinkIndex_OnRouteUpdate, index);
+	return index;
+}
+
+static void RouterLinkIndex_Destroy(RouterLinkIndex index)
+{
+	router_unwatch(index->router, index->watcher);
+	LinkedList_Unlink(&router_link_indexes, &index->node);
+	Dict_Release(index->exact_links);
+	if (index->trie.children) {
+		Dict_Release(index->trie.children);
+	}
+	free(index);
+}
+
+static LinkedList *RouterLinkIndex_GetBucket(RouterLinkIndex index,
+					     RouterLink link)
+{
+	char *key;
+	char *path;
+	char *p;
+	char *segment;
+	LinkedList *links;
+	const router_route_t *route;
+	RouterLinkTrieNode trie = &index->trie;
+
+	if (!link->to) {
+		return NULL;
+	}
+	if (link->depends != ROUTER_LINK_DEPENDS_NONE) {
+		return &index->dynamic_links;
+	}
+	route = RouterLink_GetResolvedRoute(link);
+	if (!route->path) {
+		return &index->dynamic_links;
+	}
+	if (link->exact) {
+		key = RouterLinkIndex_GetPathKey(route->path);
+		links = Dict_FetchValue(index->exact_links, key);
+		if (!links) {
+			links = malloc(sizeof(LinkedList));
+			LinkedList_Init(links);
+			Dict_Add(index->exact_links, key, links);
+		}
+		free(key);
+		return links;
+	}
+	path = strdup(route->path);
+	p = path;
+	while ((segment = RouterLink_NextSegment(&p))) {
+		trie = RouterLinkTrieNode_GetChild(trie, segment, TRUE);
+	}
+	free(path);
+	return &trie->links;
+}
+
+static void RouterLinkIndex_Unlink(RouterLink link)
+{
+	if (link->bucket) {
+		LinkedList_Unlink(link->bucket, &link->node);
+		link->bucket = NULL;
+	}
+	if (link->active || link->exact_active) {
+		LinkedList_Unlink(&link->index->active_links,
+				  &link->active_node);
+	}
+}
+
+static void RouterLinkIndex_Link(RouterLink link)
+{
+	link->bucket = RouterLinkIndex_GetBucket(link->index, link);
+	if (link->bucket) {
+		LinkedList_AppendNode(link->bucket, &link->node);
+	}
+	if (link->active || link->exact_active) {
+		LinkedList_AppendNode(&link->index->active_links,
+				      &link->active_node);
+	}
+	RouterLink_Update(link, router_get_current_route(link->router));
+}
+
+static void RouterLinkIndex_Add(RouterLink link)
+{
+	link->index = RouterLinkIndex_Get(link->router);
+	link->index->length++;
+	LinkedList_AppendNode(&link->index->links, &link->index_node);
+	RouterLinkIndex_Link(link);
+}
+
+static void RouterLinkIndex_Remove(RouterLink link)
+{
+	RouterLinkIndex index = link->index;
+
+	if (!index) {
+		return;
+	}
+	RouterLinkIndex_Unlink(link);
+	LinkedList_Unlink(&index->links, &link->index_node);
+	link->index = NULL;
+	index->length--;
+	if (index->length < 1) {
+		RouterLinkIndex_Destroy(index);
+	}
+}
+
+// Called when the target or the matching mode of an indexed link changes.
+
+static void RouterLinkIndex_Update(RouterLink link)
+{
+	if (link->index) {
+		RouterLinkIndex_Unlink(link);
+		RouterLinkIndex_Link(link);
+	}
 }
 
 static void RouterLink_OnClick(LCUI_Widget w, LCUI_WidgetEvent e, void *arg)
@@ -61,6 +546,88 @@ static void RouterLink_OnClick(LCUI_Widget w, LCUI_WidgetEvent e, void *arg)
 	}
 }
 
+// With prefetch="hover" the components of the target route are created
+// ahead of time when the link is hovered or focused, prefetch="idle" also
+// does it once the UI has been idle for a while after the link is ready.
+
+static void RouterLink_Prefetch(LCUI_Widget w)
+{
+	RouterLink link;
+
+	link = Widget_GetData(w, router_link_proto);
+	if (!link->router || !link->to) {
+		return;
+	}
+	RouterView_PrefetchRoute(RouterLink_GetResolvedRoute(link));
+}
+
+static void RouterLinkIdleQueue_OnTimer(void *arg);
+
+static void RouterLinkIdleQueue_Schedule(long delay)
+{
+	if (!router_link_idle_queue.timer) {
+		router_link_idle_queue.timer =
+		    LCUI_SetTimeout(delay, RouterLinkIdleQueue_OnTimer, NULL);
+	}
+}
+
+// One link is prefetched per frame while the UI stays idle, a navigation
+// in between postpones the rest until the UI is idle again.
+
+static void RouterLinkIdleQueue_OnTimer(void *arg)
+{
+	int64_t elapsed;
+	RouterLink link;
+	RouterLinkIdleQueueRec *queue = &router_link_idle_queue;
+
+	queue->timer = 0;
+	if (queue->links.length < 1) {
+		return;
+	}
+	elapsed = LCUI_GetTimeDelta(queue->active_time);
+	if (elapsed < ROUTER_LINK_IDLE_DELAY) {
+		RouterLinkIdleQueue_Schedule(
+		    (long)(ROUTER_LINK_IDLE_DELAY - elapsed));
+		return;
+	}
+	link = queue->links.head.next->data;
+	LinkedList_Unlink(&queue->links, &link->idle_node);
+	RouterLink_Prefetch(link->widget);
+	if (queue->links.length > 0) {
+		RouterLinkIdleQueue_Schedule(ROUTER_LINK_IDLE_INTERVAL);
+	}
+}
+
+static void RouterLinkIdleQueue_Add(RouterLink link)
+{
+	RouterLinkIdleQueueRec *queue = &router_link_idle_queue;
+
+	if (link->idle_node.prev) {
+		return;
+	}
+	queue->active_time = LCUI_GetTime();
+	LinkedList_AppendNode(&queue->links, &link->idle_node);
+	RouterLinkIdleQueue_Schedule(ROUTER_LINK_IDLE_DELAY);
+}
+
+static void RouterLinkIdleQueue_Remove(RouterLink link)
+{
+	if (link->idle_node.prev) {
+		LinkedList_Unlink(&router_link_idle_queue.links,
+				  &link->idle_node);
+	}
+}
+
+static void RouterLink_OnHover(LCUI_Widget w, LCUI_WidgetEvent e, void *arg)
+{
+	RouterLink link;
+
+	link = Widget_GetData(w, router_link_proto);
+	if (link->prefetch != ROUTER_LINK_PREFETCH_NONE) {
+		RouterLink_Prefetch(w);
+	}
+}
+
 static void RouterLink_OnSetAttribute(LCUI_Widget w, const char *name,
 				      const char *value)
 {
@@ -74,13 +641,29 @@ static void RouterLink_OnSetAttribute(LCUI_Widget w, const char *name,
 		router_location_destroy(location);
 	} else if (strcmp(name, "exact") == 0) {
 		RouterLink_SetExact(w, strcmp(value, "exact") == 0);
+	} else if (strcmp(name, "prefetch") == 0) {
+		if (strcmp(value, "idle") == 0) {
+			link->prefetch = ROUTER_LINK_PREFETCH_IDLE;
+		} else if (strcmp(value, "false") == 0) {
+			link->prefetch = ROUTER_LINK_PREFETCH_NONE;
+		} else {
+			link->prefetch = ROUTER_LINK_PREFETCH_HOVER;
+		}
 	} else if (strcmp(name, "exact-active-class") == 0) {
 		if (link->exact_active_class) {
+			if (link->exact_active) {
+				Widget_RemoveClass(w, link->exact_active_class);
+				Widget_AddClass(w, value);
+			}
 			free(link->exact_active_class);
 		}
 		link->exact_active_class = strdup(value);
 	} else if (strcmp(name, "active-class") == 0) {
 		if (link->active_class) {
+			if (link->active) {
+				Widget_RemoveClass(w, link->active_class);
+				Widget_AddClass(w, value);
+			}
 			free(link->active_class);
 		}
 		link->active_class = strdup(value);
@@ -108,8 +691,11 @@ static void RouterLink_OnReady(LCUI_Widget w, LCUI_WidgetEvent e, void *arg)
 		name = "default";
 	}
 	router = router_get_by_name(name);
-	link->watcher = router_watch(router, RouterLink_OnRouteUpdate, w);
 	link->router = router;
+	RouterLinkIndex_Add(link);
+	if (link->prefetch == ROUTER_LINK_PREFETCH_IDLE && Widget_IsVisible(w)) {
+		RouterLinkIdleQueue_Add(link);
+	}
 	Widget_UnbindEvent(w, "ready", RouterLink_OnReady);
 }
 
@@ -123,10 +709,34 @@ static void RouterLink_OnInit(LCUI_Widget w)
 	link->to = NULL;
 	link->replace = FALSE;
 	link->exact = FALSE;
+	link->prefetch = ROUTER_LINK_PREFETCH_NONE;
+	link->active = FALSE;
+	link->exact_active = FALSE;
 	link->router = NULL;
-	link->watcher = NULL;
+	link->stamp = 0;
+	link->widget = w;
+	link->index = NULL;
+	link->bucket = NULL;
+	link->node.data = link;
+	link->node.prev = NULL;
+	link->node.next = NULL;
+	link->index_node.data = link;
+	link->index_node.prev = NULL;
+	link->index_node.next = NULL;
+	link->active_node.data = link;
+	link->active_node.prev = NULL;
+	link->active_node.next = NULL;
+	link->idle_node.data = link;
+	link->idle_node.prev = NULL;
+	link->idle_node.next = NULL;
+	link->depends = ROUTER_LINK_DEPENDS_NONE;
+	link->routes_version = 0;
+	link->resolved = NULL;
+	link->resolved_base = NULL;
 	Widget_BindEvent(w, "ready", RouterLink_OnReady, NULL, NULL);
 	Widget_BindEvent(w, "click", RouterLink_OnClick, NULL, NULL);
+	Widget_BindEvent(w, "mouseover", RouterLink_OnHover, NULL, NULL);
+	Widget_BindEvent(w, "focus", RouterLink_OnHover, NULL, NULL);
 	router_link_proto->proto->init(w);
 }
 
@@ -135,13 +745,13 @@ static void RouterLink_OnDestroy(LCUI_Widget w)
 	RouterLink link;
 
 	link = Widget_GetData(w, router_link_proto);
-	if (link->router) {
-		router_unwatch(link->router, link->watcher);
-	}
+	RouterLinkIndex_Remove(link);
+	RouterLinkIdleQueue_Remove(link);
+	RouterLink_ClearResolvedRoute(link);
 	router_location_destroy(link->to);
 	router_mem_free(link->active_class);
 	router_mem_free(link->exact_active_class);
-	link->watcher = NULL;
+	link->router = NULL;
 	link->to = NULL;
 	router_link_proto->proto->destroy(w);
 }
@@ -154,7 +764,10 @@ void RouterLink_SetLocation(LCUI_Widget w, router_location_t *location)
 	if (link->to) {
 		router_location_destroy(link->to);
 	}
+	RouterLink_ClearResolvedRoute(link);
 	link->to = router_location_duplicate(location);
+	link->depends = RouterLink_GetDependency(link->to);
+	RouterLinkIndex_Update(link);
 }
 
 void RouterLink_SetExact(LCUI_Widget w, router_boolean_t exact)
@@ -163,10 +776,17 @@ void RouterLink_SetExact(LCUI_Widget w, router_boolean_t exact)
 
 	link = Widget_GetData(w, router_link_proto);
 	link->exact = exact;
+	RouterLinkIndex_Update(link);
 }
 
 void UI_InitRouterLink(void)
 {
+	Dict_InitStringCopyKeyType(&router_link_trie_dict_type);
+	router_link_trie_dict_type.valDestructor = RouterLinkTrieNode_Destroy;
+	LinkedList_Init(&router_link_indexes);
+	LinkedList_Init(&router_link_idle_queue.links);
+	router_link_idle_queue.timer = 0;
+	router_link_idle_queue.active_time = 0;
 	router_link_proto = LCUIWidget_NewPrototype("router-link", "textview");
 	router_link_proto->init = RouterLink_OnInit;
 	router_link_proto->setattr = RouterLink_OnSetAttribute;
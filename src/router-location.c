@@ -1,10 +1,21 @@
 ﻿#include "router.h"
 
+static void router_location_on_destroy(void *location)
+{
+	free(location);
+}
+
+static router_pool_t router_location_pool =
+    ROUTER_POOL_INIT(router_location_on_destroy);
+
 router_location_t *router_location_create(const char *name, const char *path)
 {
 	router_location_t *location;
 
-	location = malloc(sizeof(router_location_t));
+	location = router_pool_take(&router_location_pool);
+	if (!location) {
+		location = malloc(sizeof(router_location_t));
+	}
 	location->name = name ? strdup(name) : NULL;
 	location->path = path ? strdup(path) : NULL;
 	location->hash = NULL;
@@ -27,7 +38,7 @@ void router_location_destroy(router_location_t *location)
 	}
 	location->query = NULL;
 	location->params = NULL;
-	free(location);
+	router_pool_put(&router_location_pool, location);
 }
 
 router_location_t *router_location_duplicate(const router_location_t *target)
@@ -103,7 +114,7 @@ router_location_t *router_location_normalize(const router_location_t *raw,
 {
 	Dict *params;
 	router_location_t *location;
-	router_route_record_t *record;
+	const router_route_record_t *record;
 
 	if (raw->normalized || raw->name) {
 		return router_location_duplicate(raw);
@@ -118,9 +129,8 @@ router_location_t *router_location_normalize(const router_location_t *raw,
 			router_location_set_name(location, current->name);
 			router_string_dict_destroy(location->params);
 			location->params = params;
-		} else if (current->matched.length > 0) {
-			record = LinkedList_Get(&current->matched,
-						current->matched.length - 1);
+		} else if (current->matched_length > 0) {
+			record = current->matched[current->matched_length - 1];
 			if (location->path) {
 				free(location->path);
 			}
@@ -180,7 +190,8 @@ const char *router_location_get_path(const router_location_t *location)
 
 #define STR_REALLOC(STR, LEN) STR = realloc(STR, sizeof(char) * (LEN + 1))
 
-char *router_location_stringify(const router_location_t *location)
+char *router_path_stringify(const char *base_path, router_string_dict_t *query,
+			    const char *hash)
 {
 	char *path;
 	const char *str;
@@ -189,18 +200,18 @@ char *router_location_stringify(const router_location_t *location)
 	DictIterator *iter;
 	DictEntry *entry;
 
-	if (location->path) {
-		path_len = strlen(location->path);
+	if (base_path) {
+		path_len = strlen(base_path);
 		path = malloc(sizeof(char) * (path_len + 1));
-		strcpy(path, location->path);
+		strcpy(path, base_path);
 	} else {
 		path_len = 0;
 		path = malloc(sizeof(char) * (path_len + 1));
 		strcpy(path, "");
 	}
-	if (location->query) {
+	if (query) {
 		pairs = 0;
-		iter = Dict_GetIterator(location->query);
+		iter = Dict_GetIterator(query);
 		while ((entry = Dict_Next(iter))) {
 			// ?key1=value1&key2=value2
 			i = path_len;
@@ -221,11 +232,27 @@ char *router_location_stringify(const router_location_t *location)
 		}
 		Dict_ReleaseIterator(iter);
 	}
-	if (location->hash) {
+	if (hash) {
 		i = path_len;
-		path_len += strlen(location->hash);
+		path_len += strlen(hash);
 		STR_REALLOC(path, path_len);
-		strcpy(path + i, location->hash);
+		strcpy(path + i, hash);
 	}
 	return path;
 }
+
+char *router_location_stringify(const router_location_t *location)
+{
+	return router_path_stringify(location->path, location->query,
+				     location->hash);
+}
+
+void router_location_pool_get_stats(router_pool_stats_t *stats)
+{
+	router_pool_get_stats(&router_location_pool, stats);
+}
+
+void router_location_pool_clear(void)
+{
+	router_pool_clear(&router_location_pool);
+}
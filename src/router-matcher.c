@@ -1,4 +1,5 @@
 ﻿#include "router.h"
+#include <LCUI/thread.h>
 
 router_matcher_t *router_matcher_create(void)
 {
@@ -10,35 +11,277 @@ router_matcher_t *router_matcher_create(void)
 	matcher->name_map = Dict_Create(&type, NULL);
 	matcher->path_map = Dict_Create(&type, NULL);
 	LinkedList_Init(&matcher->path_list);
+	LinkedList_Init(&matcher->retired_tables);
+	matcher->table = NULL;
+	matcher->readers = 0;
+	LCUIMutex_Init(&matcher->workers.mutex);
+	LCUICond_Init(&matcher->workers.job_posted);
+	LCUICond_Init(&matcher->workers.job_done);
+	matcher->workers.length = 0;
+	matcher->workers.active = 0;
+	matcher->workers.job_id = 0;
+	matcher->workers.job = NULL;
+	matcher->workers.busy = FALSE;
+	matcher->workers.exiting = FALSE;
 	return matcher;
 }
 
+static void router_route_table_destroy(void *data)
+{
+	router_route_table_t *table = data;
+
+	free(table->records);
+	free(table);
+}
+
 static void router_matcher_on_destroy_record(void *data)
 {
 	router_route_record_destroy(data);
 }
 
+static void router_match_workers_stop(router_match_workers_t *workers)
+{
+	size_t i;
+
+	LCUIMutex_Lock(&workers->mutex);
+	workers->exiting = TRUE;
+	LCUICond_Broadcast(&workers->job_posted);
+	LCUIMutex_Unlock(&workers->mutex);
+	for (i = 0; i < workers->length; ++i) {
+		LCUIThread_Join(workers->threads[i], NULL);
+	}
+	LCUICond_Destroy(&workers->job_posted);
+	LCUICond_Destroy(&workers->job_done);
+	LCUIMutex_Destroy(&workers->mutex);
+}
+
 void router_matcher_destroy(router_matcher_t *matcher)
 {
+	router_match_workers_stop(&matcher->workers);
 	Dict_Release(matcher->name_map);
 	Dict_Release(matcher->path_map);
 	LinkedList_ClearData(&matcher->path_list,
 			     router_matcher_on_destroy_record);
+	LinkedList_Clear(&matcher->retired_tables, router_route_table_destroy);
+	if (matcher->table) {
+		router_route_table_destroy(matcher->table);
+	}
 	matcher->name_map = NULL;
 	matcher->path_map = NULL;
 	free(matcher);
 }
 
+static void router_matcher_link_record(router_matcher_t *matcher,
+				       router_route_record_t *record,
+				       const router_route_record_t *parent)
+{
+	size_t i, len;
+	router_route_record_t *item;
+	LinkedListNode *node;
+
+	if (!Dict_FetchValue(matcher->path_map, record->path)) {
+		LinkedList_AppendNode(&matcher->path_list, &record->node);
+		Dict_Add(matcher->path_map, record->path, record);
+	}
+	if (parent) {
+		// a record with a duplicate path was never linked
+		if (record->node.prev) {
+			LinkedList_Unlink(&matcher->path_list, &record->node);
+		}
+		LinkedList_Link(&matcher->path_list, parent->node.prev,
+				&record->node);
+	}
+	len = matcher->path_list.length;
+	node = matcher->path_list.head.next;
+	// ensure wildcard routes are always at the end
+	for (i = 0; node && i < len; ++i, node = node->next) {
+		item = node->data;
+		if (strcmp(item->path, "*") == 0) {
+			LinkedList_Unlink(&matcher->path_list, node);
+			LinkedList_AppendNode(&matcher->path_list, node);
+			i--;
+			len--;
+		}
+	}
+	router_route_record_set_parent(record, parent);
+}
+
+// Publishes a new table built from the path list. A reader that loaded the
+// old table has already been counted, so the retired tables can be freed
+// as soon as the counter drops to zero after the swap.
+
+static void router_matcher_publish(router_matcher_t *matcher)
+{
+	size_t i = 0;
+	router_route_table_t *table;
+	router_route_table_t *retired;
+	router_linkedlist_node_t *node;
+
+	table = malloc(sizeof(router_route_table_t));
+	table->length = matcher->path_list.length;
+	table->records =
+	    malloc(sizeof(router_route_record_t *) * (table->length + 1));
+	for (LinkedList_Each(node, &matcher->path_list)) {
+		table->records[i++] = node->data;
+	}
+	retired = router_atomic_exchange_ptr(&matcher->table, table);
+	if (retired) {
+		LinkedList_Append(&matcher->retired_tables, retired);
+	}
+	if (router_atomic_load(&matcher->readers) == 0) {
+		LinkedList_Clear(&matcher->retired_tables,
+				 router_route_table_destroy);
+	}
+}
+
+// Finds the record a redirect path leads to and captures its params. The
+// values are still the params of the redirect path, such as ":id". A param
+// segment that equals the one of the record is not captured by the
+// matcher, so it is added here as is.
+
+static const router_route_record_t *router_matcher_find_record(
+    router_matcher_t *matcher, const char *path, router_string_dict_t *params)
+{
+	char key[256];
+	const router_route_record_t *record;
+	router_linkedlist_t keys;
+	router_linkedlist_node_t *node;
+
+	record = Dict_FetchValue(matcher->path_map, path);
+	if (record) {
+		record = record->alias_of ? record->alias_of : record;
+	} else {
+		record = router_matcher_match_record(matcher, path, params);
+	}
+	if (!record) {
+		return NULL;
+	}
+	LinkedList_Init(&keys);
+	router_path_parse_keys(record->path, &keys);
+	for (LinkedList_Each(node, &keys)) {
+		if (!Dict_FetchValue(params, node->data)) {
+			snprintf(key, sizeof(key), ":%s", (char *)node->data);
+			router_string_dict_set(params, node->data, key);
+		}
+	}
+	LinkedList_Clear(&keys, free);
+	return record;
+}
+
+// Returns TRUE if every parameter of the redirect path can be filled with
+// the parameters of the record that redirects to it.
+
+static router_boolean_t router_matcher_check_redirect_params(
+    const router_route_record_t *record)
+{
+	router_boolean_t found = TRUE;
+	router_linkedlist_t keys;
+	router_linkedlist_t redirect_keys;
+	router_linkedlist_node_t *node;
+	router_linkedlist_node_t *key_node;
+
+	LinkedList_Init(&keys);
+	LinkedList_Init(&redirect_keys);
+	router_path_parse_keys(record->path, &keys);
+	router_path_parse_keys(record->redirect, &redirect_keys);
+	for (LinkedList_Each(node, &redirect_keys)) {
+		found = FALSE;
+		for (LinkedList_Each(key_node, &keys)) {
+			if (strcmp(key_node->data, node->data) == 0) {
+				found = TRUE;
+				break;
+			}
+		}
+		if (!found) {
+			Logger_Error("[router] redirect parameter \"%s\" is "
+				     "missing in the source route: "
+				     "{ path: \"%s\", redirect: \"%s\" }\n",
+				     (char *)node->data, record->path,
+				     record->redirect);
+			break;
+		}
+	}
+	LinkedList_Clear(&keys, free);
+	LinkedList_Clear(&redirect_keys, free);
+	return found;
+}
+
+// Follows the redirect chain of a record hop by hop. The params each hop
+// captures from the current path are filled into the redirect of the next
+// hop, so a chain may rename params, e.g. /a/:x -> /b/:x, /b/:y -> /c/:y
+// compiles to /c/:x.
+
+static void router_matcher_compile_redirect(router_matcher_t *matcher,
+					    router_route_record_t *record)
+{
+	size_t steps;
+	char *path;
+	const router_route_record_t *target;
+	router_string_dict_t *params;
+
+	router_mem_free(record->redirect_path);
+	record->redirect_record = NULL;
+	if (!router_matcher_check_redirect_params(record)) {
+		return;
+	}
+	params = router_string_dict_create();
+	path = strdup(record->redirect);
+	for (steps = 0;; ++steps) {
+		router_string_dict_clear(params);
+		target = router_matcher_find_record(matcher, path, params);
+		if (!target || !target->redirect) {
+			break;
+		}
+		free(path);
+		path = NULL;
+		if (steps >= matcher->path_list.length) {
+			Logger_Error("[router] redirect cycle detected: "
+				     "{ path: \"%s\", redirect: \"%s\" }\n",
+				     record->path, record->redirect);
+			target = NULL;
+			break;
+		}
+		path = router_path_fill_params(target->redirect, params);
+		if (!path) {
+			Logger_Error("[router] redirect chain can not be "
+				     "followed: { path: \"%s\", redirect: "
+				     "\"%s\" }\n",
+				     target->path, target->redirect);
+			target = NULL;
+			break;
+		}
+	}
+	router_string_dict_destroy(params);
+	record->redirect_path = path;
+	record->redirect_record = target;
+}
+
+// Chains are compiled again after each registration to pick up targets
+// that were registered later.
+
+static void router_matcher_compile_redirects(router_matcher_t *matcher)
+{
+	router_route_record_t *record;
+	router_linkedlist_node_t *node;
+
+	for (LinkedList_Each(node, &matcher->path_list)) {
+		record = node->data;
+		if (record->redirect) {
+			router_matcher_compile_redirect(matcher, record);
+		}
+	}
+}
+
 // https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L1282
 
 router_route_record_t *router_matcher_add_route_record(
     router_matcher_t *matcher, const router_config_t *config,
     const router_route_record_t *parent)
 {
-	size_t i, len;
+	router_route_record_t *alias;
 	router_route_record_t *record;
 	const char *base_path = parent ? parent->path : NULL;
-	LinkedListNode *node;
+	router_linkedlist_node_t *node;
 
 	record = router_route_record_create();
 	record->path = router_path_resolve(config->path, base_path, TRUE);
@@ -55,115 +298,136 @@ router_route_record_t *router_matcher_add_route_record(
 		record->name = strdup(config->name);
 		Dict_Add(matcher->name_map, record->name, record);
 	}
-	if (!Dict_FetchValue(matcher->path_map, record->path)) {
-		LinkedList_AppendNode(&matcher->path_list, &record->node);
-		Dict_Add(matcher->path_map, record->path, record);
+	if (config->redirect) {
+		record->redirect =
+		    router_path_resolve(config->redirect, base_path, TRUE);
 	}
-	if (parent) {
-		LinkedList_Unlink(&matcher->path_list, &record->node);
-		LinkedList_Link(&matcher->path_list, parent->node.prev,
-				&record->node);
+	router_matcher_link_record(matcher, record, parent);
+	// an alias only adds a path to match, the route uses the target record
+	for (LinkedList_Each(node, &config->aliases)) {
+		alias = router_route_record_create();
+		alias->path = router_path_resolve(node->data, base_path, TRUE);
+		alias->alias_of = record;
+		router_matcher_link_record(matcher, alias, parent);
 	}
-	len = matcher->path_list.length;
-	node = matcher->path_list.head.next;
-	// ensure wildcard routes are always at the end
-	for (i = 0; node && i < len; ++i, node = node->next) {
-		if (strcmp(((router_route_t *)node->data)->path, "*") == 0) {
-			LinkedList_Unlink(&matcher->path_list, node);
-			LinkedList_AppendNode(&matcher->path_list, node);
-			i--;
-			len--;
-		}
-	}
-	record->parent = parent;
+	router_matcher_publish(matcher);
+	router_matcher_compile_redirects(matcher);
 	return record;
 }
 
+static void router_matcher_set_param(Dict *params, const char *key,
+				     size_t key_len, const char *value,
+				     size_t value_len)
+{
+	char buf[256];
+	char *str = buf;
+
+	if (!params) {
+		return;
+	}
+	if (key_len + value_len + 2 > sizeof(buf)) {
+		str = malloc(sizeof(char) * (key_len + value_len + 2));
+	}
+	memcpy(str, key, key_len);
+	str[key_len] = 0;
+	memcpy(str + key_len + 1, value, value_len);
+	str[key_len + 1 + value_len] = 0;
+	router_string_dict_set(params, str, str + key_len + 1);
+	if (str != buf) {
+		free(str);
+	}
+}
+
+static const char *router_matcher_segment_end(const char *segment)
+{
+	const char *end = strchr(segment, '/');
+
+	return end ? end : segment + strlen(segment);
+}
+
 // https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L1599
 
-router_boolean_t router_matcher_match_route(router_route_record_t *record,
+// Walks the path and the record path segment by segment in place, so that
+// nothing is allocated unless a param is captured. Params may be NULL.
+
+router_boolean_t router_matcher_match_route(const router_route_record_t *record,
 					    const char *path, Dict *params)
 {
-	char **nodes;
-	char **record_nodes;
-	char *path_match = NULL;
-	size_t i, j;
-	size_t nodes_count;
-	size_t record_nodes_count;
-	size_t path_match_len = 0;
-	size_t path_match_i = 0;
-	router_boolean_t matched = TRUE;
-	router_boolean_t match_all = FALSE;
-
-	nodes_count = strsplit(path, "/", &nodes);
-	record_nodes_count = strsplit(record->path, "/", &record_nodes);
+	const char *p = path;
+	const char *q = record->path;
+	const char *p_end;
+	const char *q_end;
+	size_t p_len, q_len;
+
 	// record->path: "/example/:type/:name/info"
 	// path: "/exmaple/food/orange/info"
-	for (i = 0, j = 0; i < nodes_count && j < record_nodes_count; ++i) {
-		if (!match_all && strcmp(record_nodes[j], "*") == 0) {
+	while (1) {
+		p_end = router_matcher_segment_end(p);
+		q_end = router_matcher_segment_end(q);
+		p_len = p_end - p;
+		q_len = q_end - q;
+		if (q_len == 1 && *q == '*') {
 			// record->path: /files/*
 			// path: /files/path/to/file
-			// path_match: path/to/file
-			if (j + 1 != record_nodes_count) {
+			// pathMatch: path/to/file
+			if (*q_end) {
 				Logger_Warning("[router] the asterisk should "
 					       "be at the end\n");
 			}
-			match_all = TRUE;
+			router_matcher_set_param(params, "pathMatch", 9, p,
+						 strlen(p));
+			return TRUE;
 		}
-		if (match_all) {
-			if (path_match_len > 0) {
-				path_match_len += 1;
-			}
-			path_match_len += strlen(nodes[i]);
-			path_match = realloc(
-			    path_match, sizeof(char) * (path_match_len + 1));
-			if (path_match_i > 0) {
-				strcpy(path_match + path_match_i, "/");
-				++path_match_i;
-			}
-			strcpy(path_match + path_match_i, nodes[i]);
-			path_match_i = path_match_len;
-			continue;
-		}
-		if (strcmp(record_nodes[j], nodes[i]) == 0) {
-		} else if (record_nodes[j][0] == ':') {
-			router_string_dict_set(params, record_nodes[j] + 1,
-					       nodes[i]);
-		} else if (strcmp(record_nodes[j], nodes[i]) != 0) {
-			matched = FALSE;
-			break;
+		if (p_len == q_len && strncmp(p, q, p_len) == 0) {
+		} else if (*q == ':') {
+			router_matcher_set_param(params, q + 1, q_len - 1, p,
+						 p_len);
+		} else {
+			return FALSE;
 		}
-		++j;
-	}
-	if (path_match) {
-		matched = matched && i == nodes_count;
-		if (matched) {
-			router_string_dict_set(params, "pathMatch", path_match);
+		if (!*p_end || !*q_end) {
+			return !*p_end && !*q_end;
 		}
-		free(path_match);
-	} else {
-		matched = matched && nodes_count == record_nodes_count;
+		p = p_end + 1;
+		q = q_end + 1;
 	}
-	for (i = 0; i < nodes_count; ++i) {
-		free(nodes[i]);
+}
+
+// Moves a location that matched a redirecting record to the compiled target
+// of its redirect chain. The location is left as is if the redirect path can
+// not be filled with its parameters.
+
+static const router_route_record_t *router_matcher_redirect(
+    const router_route_record_t *record, router_location_t *location)
+{
+	char *path;
+
+	if (!record || !record->redirect_path) {
+		return record;
+	}
+	path = router_path_fill_params(record->redirect_path, location->params);
+	if (!path) {
+		return record;
 	}
-	for (i = 0; i < record_nodes_count; ++i) {
-		free(record_nodes[i]);
+	router_mem_free(location->path);
+	router_mem_free(location->name);
+	location->path = path;
+	record = record->redirect_record;
+	router_string_dict_clear(location->params);
+	if (record) {
+		router_matcher_match_route(record, location->path,
+					   location->params);
 	}
-	free(nodes);
-	free(record_nodes);
-	return matched;
+	return record;
 }
 
-// https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L1457
-
 router_route_t *router_matcher_match_by_name(
     router_matcher_t *matcher, router_location_t *location,
     const router_route_t *current_route)
 {
 	char *key;
-	char *value;
-	router_route_record_t *record;
+	const char *value;
+	const router_route_record_t *record;
 	router_linkedlist_t param_names;
 	router_linkedlist_node_t *node;
 
@@ -171,7 +435,7 @@ router_route_t *router_matcher_match_by_name(
 	if (!record) {
 		Logger_Warning("[router] route with name '%s' does not exist",
 			       location->name);
-		return router_route_create(NULL, location);
+		return router_route_create_from(NULL, location);
 	}
 	if (!location->params) {
 		location->params = router_string_dict_create();
@@ -181,34 +445,203 @@ router_route_t *router_matcher_match_by_name(
 		router_path_parse_keys(record->path, &param_names);
 		for (LinkedList_Each(node, &param_names)) {
 			key = node->data;
-			value = Dict_FetchValue(current_route->params, key);
+			value = router_route_get_param(current_route, key);
 			if (value && !Dict_FetchValue(location->params, key)) {
 				router_string_dict_set(location->params, key, value);
 			}
 		}
 		LinkedList_Clear(&param_names, free);
 	}
+	router_mem_free(location->path);
 	location->path =
 	    router_path_fill_params(record->path, location->params);
-	return router_route_create(record, location);
+	record = router_matcher_redirect(record, location);
+	return router_route_create_from(record, location);
 }
 
 // https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L1481
 
+static const router_route_record_t *router_route_table_match(
+    const router_route_table_t *table, const char *path,
+    router_string_dict_t *params)
+{
+	size_t i;
+	const router_route_record_t *record;
+
+	for (i = 0; table && i < table->length; ++i) {
+		record = table->records[i];
+		if (router_matcher_match_route(record, path, params)) {
+			return record->alias_of ? record->alias_of : record;
+		}
+	}
+	return NULL;
+}
+
+// Safe to call from any thread while routes are being added, as long as
+// params is not used by another thread at the same time. String dicts can
+// be created and destroyed on any thread.
+
+const router_route_record_t *router_matcher_match_record(
+    router_matcher_t *matcher, const char *path, router_string_dict_t *params)
+{
+	const router_route_record_t *record;
+
+	router_atomic_increment(&matcher->readers);
+	record = router_route_table_match(
+	    router_atomic_load_ptr(&matcher->table), path, params);
+	router_atomic_decrement(&matcher->readers);
+	return record;
+}
+
+// Only answers which record a path matches, nothing is allocated.
+
+const router_route_record_t *router_matcher_test(router_matcher_t *matcher,
+						 const char *path)
+{
+	return router_matcher_match_record(matcher, path, NULL);
+}
+
+// Workers, including the calling thread, claim chunks of the batch from a
+// shared cursor until it runs out, so a slow chunk never holds up the rest.
+
+static void router_match_job_run(void *arg)
+{
+	long start;
+	long matched = 0;
+	size_t i, end;
+	router_match_job_t *job = arg;
+
+	while ((start = router_atomic_fetch_add(&job->next,
+						ROUTER_MATCH_CHUNK_SIZE)) <
+	       (long)job->count) {
+		end = start + ROUTER_MATCH_CHUNK_SIZE;
+		if (end > job->count) {
+			end = job->count;
+		}
+		for (i = start; i < end; ++i) {
+			job->results[i].record = router_route_table_match(
+			    job->table, job->paths[i], job->results[i].params);
+			if (job->results[i].record) {
+				matched++;
+			}
+		}
+	}
+	router_atomic_fetch_add(&job->matched, matched);
+}
+
+// Waits for posted batches and joins each one until the matcher is
+// destroyed. The last worker to finish a batch wakes up its caller.
+
+static void router_match_worker_run(void *arg)
+{
+	size_t job_id = 0;
+	router_match_job_t *job;
+	router_match_workers_t *workers = arg;
+
+	LCUIMutex_Lock(&workers->mutex);
+	while (1) {
+		while (!workers->exiting && workers->job_id == job_id) {
+			LCUICond_Wait(&workers->job_posted, &workers->mutex);
+		}
+		if (workers->exiting) {
+			break;
+		}
+		job_id = workers->job_id;
+		job = workers->job;
+		LCUIMutex_Unlock(&workers->mutex);
+		router_match_job_run(job);
+		LCUIMutex_Lock(&workers->mutex);
+		if (--workers->active == 0) {
+			LCUICond_Signal(&workers->job_done);
+		}
+	}
+	LCUIMutex_Unlock(&workers->mutex);
+}
+
+// Posts a batch to the workers, starting them on the first batch. Returns
+// FALSE if the batch should be matched on the calling thread alone.
+
+static router_boolean_t router_match_workers_post(
+    router_match_workers_t *workers, router_match_job_t *job)
+{
+	LCUIMutex_Lock(&workers->mutex);
+	if (workers->busy) {
+		LCUIMutex_Unlock(&workers->mutex);
+		return FALSE;
+	}
+	// no batch has been posted yet, so new workers start at job_id 0
+	for (; workers->length < ROUTER_MATCH_MAX_THREADS - 1 &&
+	       workers->job_id == 0;
+	     ++workers->length) {
+		if (LCUIThread_Create(&workers->threads[workers->length],
+				      router_match_worker_run, workers) != 0) {
+			break;
+		}
+	}
+	if (workers->length < 1) {
+		LCUIMutex_Unlock(&workers->mutex);
+		return FALSE;
+	}
+	workers->busy = TRUE;
+	workers->job = job;
+	workers->job_id++;
+	workers->active = workers->length;
+	LCUICond_Broadcast(&workers->job_posted);
+	LCUIMutex_Unlock(&workers->mutex);
+	return TRUE;
+}
+
+static void router_match_workers_wait(router_match_workers_t *workers)
+{
+	LCUIMutex_Lock(&workers->mutex);
+	while (workers->active > 0) {
+		LCUICond_Wait(&workers->job_done, &workers->mutex);
+	}
+	workers->job = NULL;
+	workers->busy = FALSE;
+	LCUIMutex_Unlock(&workers->mutex);
+}
+
+// Matches a batch of paths against one snapshot of the route table. The
+// params of each result are filled when the caller provides a dict, on
+// whichever thread matches that path.
+
+size_t router_matcher_match_many(router_matcher_t *matcher, const char **paths,
+				 size_t count, router_match_result_t *results)
+{
+	router_boolean_t posted = FALSE;
+	router_match_job_t job;
+
+	job.paths = paths;
+	job.results = results;
+	job.count = count;
+	job.next = 0;
+	job.matched = 0;
+	router_atomic_increment(&matcher->readers);
+	job.table = router_atomic_load_ptr(&matcher->table);
+	if (count >= ROUTER_MATCH_PARALLEL_THRESHOLD) {
+		posted = router_match_workers_post(&matcher->workers, &job);
+	}
+	router_match_job_run(&job);
+	if (posted) {
+		router_match_workers_wait(&matcher->workers);
+	}
+	router_atomic_decrement(&matcher->readers);
+	return job.matched;
+}
+
 router_route_t *router_matcher_match_by_path(router_matcher_t *matcher,
 					     router_location_t *location)
 {
-	router_route_record_t *record;
-	router_linkedlist_node_t *node;
+	const router_route_record_t *record;
 
-	for (LinkedList_Each(node, &matcher->path_list)) {
-		record = node->data;
-		if (router_matcher_match_route(record, location->path,
-					       location->params)) {
-			return router_route_create(record, location);
-		}
+	if (!location->params) {
+		location->params = router_string_dict_create();
 	}
-	return router_route_create(NULL, location);
+	record =
+	    router_matcher_match_record(matcher, location->path, location->params);
+	record = router_matcher_redirect(record, location);
+	return router_route_create_from(record, location);
 }
 
 // https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L1449
@@ -228,7 +661,7 @@ router_route_t *router_matcher_match(router_matcher_t *matcher,
 	} else if (location->path) {
 		route = router_matcher_match_by_path(matcher, location);
 	} else {
-		route = router_route_create(NULL, location);
+		route = router_route_create_from(NULL, location);
 	}
 	router_location_destroy(location);
 	return route;
@@ -0,0 +1,277 @@
+﻿#include "router.h"
+#include <LCUI/main.h>
+
+// A navigation is resolved by router_navigate() and committed later by a
+// task on the UI thread. A newer navigation, sync or async, cancels the
+// older ones, their loaders can check router_navigation_is_cancelled() to
+// stop early. Resolving stays on the calling thread because it reads the
+// current route, the guards and the matcher's name index and redirects,
+// which only the UI thread may change. Only the cancelled flag is shared
+// with other threads, the router is never touched off the UI thread.
+
+static void router_navigation_destroy(router_navigation_t *navigation)
+{
+	if (navigation->router) {
+		LinkedList_Unlink(&navigation->router->navigations,
+				  &navigation->node);
+	}
+	if (navigation->route) {
+		router_route_unref(navigation->route);
+	}
+	free(navigation);
+}
+
+static void router_navigation_finish(router_navigation_t *navigation,
+				     router_navigation_status_t status)
+{
+	if (navigation->callback) {
+		navigation->callback(navigation->data, status);
+	}
+	router_navigation_destroy(navigation);
+}
+
+static void router_navigation_on_commit(void *arg1, void *arg2)
+{
+	router_navigation_t *navigation = arg1;
+	router_history_t *history;
+
+	if (router_navigation_is_cancelled(navigation)) {
+		router_navigation_finish(navigation,
+					 ROUTER_NAVIGATION_CANCELLED);
+		return;
+	}
+	if (!navigation->allowed) {
+		router_navigation_finish(navigation, ROUTER_NAVIGATION_ABORTED);
+		return;
+	}
+	history = navigation->router->history;
+	if (!history->current ||
+	    !router_is_same_route(navigation->route, history->current)) {
+		if (navigation->replace) {
+			router_history_replace(history, navigation->route);
+		} else {
+			router_history_push(history, navigation->route);
+		}
+		navigation->route = NULL;
+	}
+	router_navigation_finish(navigation, ROUTER_NAVIGATION_DONE);
+}
+
+size_t router_navigate(router_t *router, router_location_t *location,
+		       router_boolean_t replace,
+		       router_navigation_callback_t callback, void *data)
+{
+	size_t id;
+	router_resolved_t *resolved;
+	router_navigation_t *navigation;
+
+	resolved = router_resolve(router, location, FALSE);
+	router_cancel_navigations(router);
+	navigation = malloc(sizeof(router_navigation_t));
+	navigation->id = ++router->navigation_id;
+	navigation->cancelled = 0;
+	navigation->router = router;
+	navigation->route = router_guard_route(router, resolved->route);
+	navigation->replace = replace;
+	navigation->allowed = navigation->route != NULL;
+	navigation->callback = callback;
+	navigation->data = data;
+	navigation->node.data = navigation;
+	resolved->route = NULL;
+	router_resolved_destroy(resolved);
+	LinkedList_AppendNode(&router->navigations, &navigation->node);
+	id = navigation->id;
+	if (router->navigation_loader && navigation->allowed) {
+		router->navigation_loader(router->navigation_loader_data,
+					  navigation);
+	} else {
+		router_navigation_next(navigation, TRUE);
+	}
+	return id;
+}
+
+void router_cancel_navigations(router_t *router)
+{
+	router_linkedlist_node_t *node;
+	router_navigation_t *navigation;
+
+	for (LinkedList_Each(node, &router->navigations)) {
+		navigation = node->data;
+		router_atomic_exchange(&navigation->cancelled, 1);
+	}
+}
+
+// The loader is called for every navigation and must call
+// router_navigation_next() exactly once, from any thread.
+
+void router_set_navigation_loader(router_t *router,
+				  router_navigation_loader_t loader, void *data)
+{
+	router->navigation_loader = loader;
+	router->navigation_loader_data = data;
+}
+
+const router_route_t *router_navigation_get_route(
+    const router_navigation_t *navigation)
+{
+	return navigation->route;
+}
+
+router_boolean_t router_navigation_is_cancelled(
+    const router_navigation_t *navigation)
+{
+	return router_atomic_load(
+		   (volatile long *)&navigation->cancelled) != 0;
+}
+
+void router_navigation_next(router_navigation_t *navigation,
+			    router_boolean_t allow)
+{
+	LCUI_TaskRec task = { 0 };
+
+	navigation->allowed = navigation->allowed && allow;
+	task.func = router_navigation_on_commit;
+	task.arg[0] = navigation;
+	LCUI_PostTask(&task);
+}
+
+// Pending navigations outlive their router until their commit task runs,
+// so they are cancelled and lose the reference to it.
+
+void router_detach_navigations(router_t *router)
+{
+	router_navigation_t *navigation;
+
+	router_cancel_navigations(router);
+	while (router->navigations.length > 0) {
+		navigation = router->navigations.head.next->data;
+		LinkedList_Unlink(&router->navigations, &navigation->node);
+		navigation->router = NULL;
+	}
+}
+
+void router_request_queue_init(router_request_queue_t *queue)
+{
+	queue->stub.next = NULL;
+	queue->stub.path = NULL;
+	queue->head = &queue->stub;
+	queue->tail = &queue->stub;
+}
+
+static void router_request_queue_push(router_request_queue_t *queue,
+				      router_request_t *request)
+{
+	router_request_t *prev;
+
+	request->next = NULL;
+	prev = router_atomic_exchange_ptr(&queue->head, request);
+	router_atomic_store_ptr(&prev->next, request);
+}
+
+// Returns NULL when the queue is empty or when a producer is halfway
+// through a push, the request shows up on the next drain in that case.
+
+static router_request_t *router_request_queue_pop(router_request_queue_t *queue)
+{
+	router_request_t *tail = queue->tail;
+	router_request_t *next = router_atomic_load_ptr(&tail->next);
+
+	if (tail == &queue->stub) {
+		if (!next) {
+			return NULL;
+		}
+		queue->tail = next;
+		tail = next;
+		next = router_atomic_load_ptr(&next->next);
+	}
+	if (next) {
+		queue->tail = next;
+		return tail;
+	}
+	if (tail != router_atomic_load_ptr(&queue->head)) {
+		return NULL;
+	}
+	router_request_queue_push(queue, &queue->stub);
+	next = router_atomic_load_ptr(&tail->next);
+	if (next) {
+		queue->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+void router_request_queue_clear(router_request_queue_t *queue)
+{
+	router_request_t *request;
+
+	while ((request = router_request_queue_pop(queue))) {
+		free(request->path);
+		free(request);
+	}
+}
+
+static void router_on_drain_requests(void *arg1, void *arg2)
+{
+	router_t *router = router_get_by_name(arg1);
+
+	if (router) {
+		router_drain_requests(router);
+	}
+}
+
+// Requests only carry a path, the location is created and resolved by the
+// drain on the UI thread, which owns the current route and the guards. The
+// first request after a drain posts the drain task, the task looks the
+// router up by name in case it was destroyed in the meantime.
+
+static void router_request(router_t *router, const char *path,
+			   router_boolean_t replace)
+{
+	LCUI_TaskRec task = { 0 };
+	router_request_t *request;
+
+	request = malloc(sizeof(router_request_t));
+	request->path = strdup(path);
+	request->replace = replace;
+	router_request_queue_push(&router->requests, request);
+	if (router_atomic_exchange(&router->requests_scheduled, 1) == 0) {
+		task.func = router_on_drain_requests;
+		task.arg[0] = strdup(router->name);
+		task.destroy_arg[0] = free;
+		LCUI_PostTask(&task);
+	}
+}
+
+void router_push_async(router_t *router, const char *path)
+{
+	router_request(router, path, FALSE);
+}
+
+void router_replace_async(router_t *router, const char *path)
+{
+	router_request(router, path, TRUE);
+}
+
+// Runs the queued requests as one collapsed batch, so watchers see only
+// the last route and the history gains at most one entry.
+
+void router_drain_requests(router_t *router)
+{
+	router_request_t *request;
+	router_location_t *location;
+
+	router_atomic_exchange(&router->requests_scheduled, 0);
+	router_begin_batch(router, TRUE);
+	while ((request = router_request_queue_pop(&router->requests))) {
+		location = router_location_create(NULL, request->path);
+		if (request->replace) {
+			router_replace(router, location);
+		} else {
+			router_push(router, location);
+		}
+		router_location_destroy(location);
+		free(request->path);
+		free(request);
+	}
+	router_commit(router);
+}
@@ -0,0 +1,87 @@
+#include "router.h"
+
+void router_once(router_once_t *once, void (*func)(void))
+{
+	if (router_atomic_load(once) == 2) {
+		return;
+	}
+	if (router_atomic_compare_exchange(once, 0, 1) == 0) {
+		func();
+		router_atomic_exchange(once, 2);
+		return;
+	}
+	while (router_atomic_load(once) != 2)
+		;
+}
+
+static void router_pool_lock(router_pool_t *pool)
+{
+	while (router_atomic_exchange(&pool->lock, 1) != 0) {
+		while (router_atomic_load(&pool->lock) != 0)
+			;
+	}
+}
+
+static void router_pool_unlock(router_pool_t *pool)
+{
+	router_atomic_exchange(&pool->lock, 0);
+}
+
+void *router_pool_take(router_pool_t *pool)
+{
+	void *item = NULL;
+
+	router_pool_lock(pool);
+	if (pool->length < 1) {
+		pool->misses++;
+	} else {
+		pool->hits++;
+		pool->length--;
+		item = pool->items[pool->length];
+	}
+	router_pool_unlock(pool);
+	return item;
+}
+
+void router_pool_put(router_pool_t *pool, void *item)
+{
+	router_pool_lock(pool);
+	if (pool->length >= pool->capacity) {
+		router_pool_unlock(pool);
+		pool->destroy(item);
+		return;
+	}
+	if (!pool->items) {
+		pool->items = malloc(sizeof(void *) * pool->capacity);
+	}
+	pool->items[pool->length] = item;
+	pool->length++;
+	router_pool_unlock(pool);
+}
+
+void router_pool_clear(router_pool_t *pool)
+{
+	void **items;
+	size_t length;
+
+	router_pool_lock(pool);
+	items = pool->items;
+	length = pool->length;
+	pool->items = NULL;
+	pool->length = 0;
+	router_pool_unlock(pool);
+	while (length > 0) {
+		length--;
+		pool->destroy(items[length]);
+	}
+	router_mem_free(items);
+}
+
+void router_pool_get_stats(const router_pool_t *pool,
+			   router_pool_stats_t *stats)
+{
+	stats->hits = pool->hits;
+	stats->misses = pool->misses;
+	stats->length = pool->length;
+	stats->capacity = pool->capacity;
+}
@@ -1,5 +1,10 @@
 ﻿#include "router.h"
 
+// Bumped whenever a record guard is added, so that records compile their
+// guard chains again on the next navigation.
+
+static size_t router_guards_version = 0;
+
 router_route_record_t *router_route_record_create(void)
 {
 	router_route_record_t *record;
@@ -12,6 +17,22 @@ router_route_record_t *router_route_record_create(void)
 	record->node.prev = NULL;
 	record->node.next = NULL;
 	record->parent = NULL;
+	record->depth = 1;
+	record->matched = malloc(sizeof(router_route_record_t *));
+	record->matched[0] = record;
+	record->redirect = NULL;
+	record->redirect_path = NULL;
+	record->redirect_record = NULL;
+	record->alias_of = NULL;
+	record->enter_guards.length = 0;
+	record->enter_guards.items = NULL;
+	record->leave_guards.length = 0;
+	record->leave_guards.items = NULL;
+	record->guards_version = 0;
+	record->enter_chain = NULL;
+	record->enter_offsets = NULL;
+	record->leave_chain = NULL;
+	record->leave_ends = NULL;
 	return record;
 }
 
@@ -23,9 +44,20 @@ void router_route_record_destroy(router_route_record_t *record)
 	if (record->path) {
 		free(record->path);
 	}
+	router_mem_free(record->redirect);
+	router_mem_free(record->redirect_path);
 	record->name = NULL;
 	record->path = NULL;
+	record->depth = 0;
+	free(record->matched);
+	record->matched = NULL;
 	Dict_Release(record->components);
+	router_mem_free(record->enter_guards.items);
+	router_mem_free(record->leave_guards.items);
+	router_mem_free(record->enter_chain);
+	router_mem_free(record->enter_offsets);
+	router_mem_free(record->leave_chain);
+	router_mem_free(record->leave_ends);
 	free(record);
 }
 
@@ -36,6 +68,27 @@ void router_route_record_set_path(router_route_record_t *record,
 	record->path = strdup(path);
 }
 
+// Precompute the matched chain (root first, this record last) so that route
+// creation copies it with a single memcpy instead of walking parents.
+
+void router_route_record_set_parent(router_route_record_t *record,
+				    const router_route_record_t *parent)
+{
+	size_t depth = parent ? parent->depth + 1 : 1;
+
+	record->parent = parent;
+	if (depth != record->depth) {
+		record->matched = realloc(
+		    record->matched, sizeof(router_route_record_t *) * depth);
+		record->depth = depth;
+	}
+	if (parent) {
+		memcpy(record->matched, parent->matched,
+		       sizeof(router_route_record_t *) * parent->depth);
+	}
+	record->matched[depth - 1] = record;
+}
+
 const char *router_route_record_get_component(
     const router_route_record_t *record, const char *key)
 {
@@ -44,3 +97,81 @@ const char *router_route_record_get_component(
 	}
 	return router_string_dict_get(record->components, key);
 }
+
+void router_guard_list_add(router_guard_list_t *list, router_guard_t guard,
+			   void *data)
+{
+	list->items = realloc(list->items, sizeof(router_guard_entry_t) *
+					       (list->length + 1));
+	list->items[list->length].guard = guard;
+	list->items[list->length].data = data;
+	list->length++;
+}
+
+void router_route_record_before_enter(router_route_record_t *record,
+				      router_guard_t guard, void *data)
+{
+	router_guard_list_add(&record->enter_guards, guard, data);
+	router_guards_version++;
+}
+
+void router_route_record_before_leave(router_route_record_t *record,
+				      router_guard_t guard, void *data)
+{
+	router_guard_list_add(&record->leave_guards, guard, data);
+	router_guards_version++;
+}
+
+// Flattens the guards of the matched chain into two arrays. The enter chain
+// runs root first and enter_offsets[i] is where the guards of matched[i]
+// start. The leave chain runs deepest first and leave_ends[i] is where the
+// guards of matched[i] end, so the guards of the records diverging at depth
+// i are always a single contiguous range.
+
+void router_route_record_compile_guards(const router_route_record_t *record)
+{
+	size_t i;
+	size_t n_enter = 0;
+	size_t n_leave = 0;
+	const router_guard_list_t *list;
+	router_route_record_t *compiled = (router_route_record_t *)record;
+
+	if (compiled->guards_version == router_guards_version) {
+		return;
+	}
+	compiled->guards_version = router_guards_version;
+	for (i = 0; i < record->depth; ++i) {
+		n_enter += record->matched[i]->enter_guards.length;
+		n_leave += record->matched[i]->leave_guards.length;
+	}
+	compiled->enter_chain =
+	    realloc(compiled->enter_chain,
+		    sizeof(router_guard_entry_t) * (n_enter + 1));
+	compiled->leave_chain =
+	    realloc(compiled->leave_chain,
+		    sizeof(router_guard_entry_t) * (n_leave + 1));
+	compiled->enter_offsets = realloc(compiled->enter_offsets,
+					  sizeof(size_t) * (record->depth + 1));
+	compiled->leave_ends =
+	    realloc(compiled->leave_ends, sizeof(size_t) * (record->depth + 1));
+	for (n_enter = 0, i = 0; i < record->depth; ++i) {
+		list = &record->matched[i]->enter_guards;
+		compiled->enter_offsets[i] = n_enter;
+		if (list->length > 0) {
+			memcpy(compiled->enter_chain + n_enter, list->items,
+			       sizeof(router_guard_entry_t) * list->length);
+		}
+		n_enter += list->length;
+	}
+	compiled->enter_offsets[record->depth] = n_enter;
+	compiled->leave_ends[record->depth] = 0;
+	for (n_leave = 0, i = record->depth; i > 0; --i) {
+		list = &record->matched[i - 1]->leave_guards;
+		if (list->length > 0) {
+			memcpy(compiled->leave_chain + n_leave, list->items,
+			       sizeof(router_guard_entry_t) * list->length);
+		}
+		n_leave += list->length;
+		compiled->leave_ends[i - 1] = n_leave;
+	}
+}
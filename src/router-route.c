@@ -1,35 +1,143 @@
 ﻿#include "router.h"
 
-// https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L266
+static void router_route_on_destroy(void *data)
+{
+	router_route_t *route = data;
 
-router_route_t *router_route_create(const router_route_record_t *record,
-				    const router_location_t *location)
+	free(route->matched);
+	free(route);
+}
+
+static router_pool_t router_route_pool =
+    ROUTER_POOL_INIT(router_route_on_destroy);
+
+static router_route_t *router_route_alloc(const router_route_record_t *record,
+					  const char *name)
 {
 	router_route_t *route;
 
-	route = malloc(sizeof(router_route_t));
-	if (location->name) {
-		route->name = strdup(location->name);
+	route = router_pool_take(&router_route_pool);
+	if (!route) {
+		route = malloc(sizeof(router_route_t));
+		route->matched = NULL;
+		route->matched_capacity = 0;
+	}
+	route->refs = 1;
+	route->routes_version = 0;
+	if (name) {
+		route->name = strdup(name);
 	} else if (record && record->name) {
 		route->name = strdup(record->name);
 	} else {
 		route->name = NULL;
 	}
+	route->full_path = NULL;
+	route->matched_length = 0;
+	if (record) {
+		if (record->depth > route->matched_capacity) {
+			route->matched_capacity = record->depth;
+			route->matched = realloc(
+			    route->matched,
+			    sizeof(router_route_record_t *) * record->depth);
+		}
+		route->matched_length = record->depth;
+		memcpy(route->matched, record->matched,
+		       sizeof(router_route_record_t *) * record->depth);
+	}
+	return route;
+}
+
+// https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L266
+
+router_route_t *router_route_create(const router_route_record_t *record,
+				    const router_location_t *location)
+{
+	router_route_t *route;
+
+	route = router_route_alloc(record, location->name);
 	route->path = strdup(location->path ? location->path : "/");
 	route->hash = strdup(location->hash ? location->hash : "");
-	route->query = router_string_dict_duplicate(location->query);
-	route->params = router_string_dict_duplicate(location->params);
-	route->full_path = router_location_stringify(location);
-	LinkedList_Init(&route->matched);
-	while (record) {
-		LinkedList_Insert(&route->matched, 0, (void *)record);
-		record = record->parent;
+	route->query = NULL;
+	route->params = NULL;
+	if (location->query) {
+		route->query = router_string_dict_duplicate(location->query);
+	}
+	if (location->params) {
+		route->params = router_string_dict_duplicate(location->params);
 	}
 	return route;
 }
 
-void router_route_destroy(router_route_t *route)
+// Same as router_route_create(), but moves the path, hash, query and params
+// out of a temporary location instead of copying them.
+
+router_route_t *router_route_create_from(const router_route_record_t *record,
+					 router_location_t *location)
 {
+	router_route_t *route;
+
+	route = router_route_alloc(record, location->name);
+	route->path = location->path ? location->path : strdup("/");
+	route->hash = location->hash ? location->hash : strdup("");
+	route->query = location->query;
+	route->params = location->params;
+	location->path = NULL;
+	location->hash = NULL;
+	location->query = NULL;
+	location->params = NULL;
+	return route;
+}
+
+// Creates a route that shares the matched records, name and params of an
+// existing route, for navigations that only change the query or hash.
+
+router_route_t *router_route_create_sibling(
+    const router_route_t *route, const router_location_t *location)
+{
+	router_route_t *sibling;
+
+	sibling = router_route_alloc(NULL, route->name);
+	if (route->matched_length > sibling->matched_capacity) {
+		sibling->matched_capacity = route->matched_length;
+		sibling->matched =
+		    realloc(sibling->matched, sizeof(router_route_record_t *) *
+						  route->matched_length);
+	}
+	sibling->matched_length = route->matched_length;
+	memcpy(sibling->matched, route->matched,
+	       sizeof(router_route_record_t *) * route->matched_length);
+	sibling->routes_version = route->routes_version;
+	sibling->path = strdup(route->path);
+	sibling->hash = strdup(location->hash ? location->hash : "");
+	sibling->query = NULL;
+	sibling->params = NULL;
+	if (location->query) {
+		sibling->query = router_string_dict_duplicate(location->query);
+	}
+	if (route->params) {
+		sibling->params = router_string_dict_duplicate(route->params);
+	}
+	return sibling;
+}
+
+// Routes do not change once created, apart from the cached full path, so
+// sharing one between the history, links and other consumers only needs a
+// reference count.
+
+router_route_t *router_route_ref(const router_route_t *route)
+{
+	router_route_t *shared = (router_route_t *)route;
+
+	shared->refs++;
+	return shared;
+}
+
+void router_route_unref(router_route_t *route)
+{
+	route->refs--;
+	if (route->refs > 0) {
+		return;
+	}
 	router_mem_free(route->name);
 	router_mem_free(route->path);
 	router_mem_free(route->full_path);
@@ -40,18 +148,57 @@ void router_route_destroy(router_route_t *route)
 	if (route->query) {
 		router_string_dict_destroy(route->query);
 	}
-	LinkedList_Clear(&route->matched, NULL);
-	free(route);
+	route->params = NULL;
+	route->query = NULL;
+	route->matched_length = 0;
+	router_pool_put(&router_route_pool, route);
+}
+
+void router_route_destroy(router_route_t *route)
+{
+	router_route_unref(route);
 }
 
 const router_route_record_t *router_route_get_matched_record(
     const router_route_t *route, size_t index)
 {
-	return LinkedList_Get(&route->matched, index);
+	if (index >= route->matched_length) {
+		return NULL;
+	}
+	return route->matched[index];
 }
 
+// Returns the depth of the first matched record that differs between the
+// two routes, views above it can keep their components.
+
+size_t router_route_get_diverged_depth(const router_route_t *a,
+				       const router_route_t *b)
+{
+	size_t i;
+
+	if (!a || !b) {
+		return 0;
+	}
+	for (i = 0; i < a->matched_length && i < b->matched_length; ++i) {
+		if (a->matched[i] != b->matched[i]) {
+			break;
+		}
+	}
+	return i;
+}
+
+// The full path is only built when someone asks for it, most routes created
+// for comparisons never need it. It is cached on the route without a lock,
+// which is fine because routes are only used on the router's thread.
+
 const char *router_route_get_full_path(const router_route_t *route)
 {
+	router_route_t *cached = (router_route_t *)route;
+
+	if (!route->full_path) {
+		cached->full_path =
+		    router_path_stringify(route->path, route->query, route->hash);
+	}
 	return route->full_path;
 }
 
@@ -80,3 +227,13 @@ const char *router_route_get_query(const router_route_t *route, const char *key)
 	}
 	return router_string_dict_get(route->query, key);
 }
+
+void router_route_pool_get_stats(router_pool_stats_t *stats)
+{
+	router_pool_get_stats(&router_route_pool, stats);
+}
+
+void router_route_pool_clear(void)
+{
+	router_pool_clear(&router_route_pool);
+}
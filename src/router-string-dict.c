@@ -10,19 +10,68 @@ static void router_string_dict_val_free(void *privdata, void *val)
 	free(val);
 }
 
+static void router_string_dict_on_destroy(void *dict)
+{
+	Dict_Release(dict);
+}
+
+static router_pool_t router_string_dict_pool =
+    ROUTER_POOL_INIT(router_string_dict_on_destroy);
+
+// Dicts in use on other threads read the type, so it is only set once.
+
+static DictType router_string_dict_type;
+static router_once_t router_string_dict_type_once = ROUTER_ONCE_INIT;
+
+static void router_string_dict_init_type(void)
+{
+	Dict_InitStringCopyKeyType(&router_string_dict_type);
+	router_string_dict_type.valDup = router_string_dict_val_dup;
+	router_string_dict_type.valDestructor = router_string_dict_val_free;
+}
+
 router_string_dict_t *router_string_dict_create(void)
 {
-	static DictType type;
+	router_string_dict_t *dict;
 
-	Dict_InitStringCopyKeyType(&type);
-	type.valDup = router_string_dict_val_dup;
-	type.valDestructor = router_string_dict_val_free;
-	return Dict_Create(&type, NULL);
+	dict = router_pool_take(&router_string_dict_pool);
+	if (dict) {
+		return dict;
+	}
+	router_once(&router_string_dict_type_once,
+		    router_string_dict_init_type);
+	return Dict_Create(&router_string_dict_type, NULL);
 }
 
 void router_string_dict_destroy(router_string_dict_t *dict)
 {
-	Dict_Release(dict);
+	router_string_dict_clear(dict);
+	router_pool_put(&router_string_dict_pool, dict);
+}
+
+// Delete entries one by one instead of using Dict_Empty(), so the hash
+// table keeps its capacity when the dict is parked in the pool.
+
+void router_string_dict_clear(router_string_dict_t *dict)
+{
+	DictEntry *entry;
+	DictIterator *iter;
+
+	iter = Dict_GetSafeIterator(dict);
+	while ((entry = Dict_Next(iter))) {
+		Dict_Delete(dict, entry->key);
+	}
+	Dict_ReleaseIterator(iter);
+}
+
+void router_string_dict_pool_get_stats(router_pool_stats_t *stats)
+{
+	router_pool_get_stats(&router_string_dict_pool, stats);
+}
+
+void router_string_dict_pool_clear(void)
+{
+	router_pool_clear(&router_string_dict_pool);
 }
 
 void router_string_dict_delete(router_string_dict_t *dict, const char *key)
@@ -82,6 +131,12 @@ router_boolean_t router_string_dict_includes(router_string_dict_t *a,
 	DictIterator *iter;
 	const char *value;
 
+	if (!b || Dict_Size(b) < 1) {
+		return TRUE;
+	}
+	if (!a) {
+		return FALSE;
+	}
 	iter = Dict_GetIterator(b);
 	while ((entry = Dict_Next(iter))) {
 		value = Dict_FetchValue(a, entry->key);
@@ -97,7 +152,10 @@ router_boolean_t router_string_dict_includes(router_string_dict_t *a,
 router_boolean_t router_string_dict_equal(router_string_dict_t *a,
 					  router_string_dict_t *b)
 {
-	if (Dict_Size(a) != Dict_Size(b)) {
+	size_t a_size = a ? Dict_Size(a) : 0;
+	size_t b_size = b ? Dict_Size(b) : 0;
+
+	if (a_size != b_size) {
 		return FALSE;
 	}
 	return router_string_dict_includes(a, b);
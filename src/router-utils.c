@@ -13,7 +13,7 @@ const char *router_path_parse_key(const char *path, char key[256],
 			if (*key_len > 1) {
 				--(*key_len);
 				key[*key_len] = 0;
-				return p + 1;
+				return *p ? p + 1 : p;
 			}
 			if (!*p) {
 				break;
@@ -46,51 +46,38 @@ size_t router_path_parse_keys(const char *path, router_linkedlist_t *keys)
 	return keys->length;
 }
 
+// path: /repos/:user/:repo/tree, params: { user: 'root', repo: 'example' }
+// full_path: /repos/root/example/tree
+
 char *router_path_fill_params(const char *path, router_string_dict_t *params)
 {
-	const char *next;
-	const char *prev;
+	const char *p;
 	const char *value;
 	char key[256];
 	char *full_path;
-	size_t key_len = 0;
+	size_t key_len;
 	size_t value_len;
 	size_t full_path_len;
 	size_t i = 0;
 
-	prev = next = path;
 	full_path_len = strlen(path) + 1;
 	full_path = malloc(sizeof(char) * full_path_len);
-	// path: /repos/:user/:repo/tree, params: { user: 'root', repo: 'example' }
-	// full_path:
-	// [/repos/:user/:repo/tree]
-	// prev: 0, next: 13, value: /repos/, full_path: /repos/
-	// fill param, full_path: /repos/admin
-	// /repos/:user/[:repo/tree]
-	// prev: 13, next: 19, value: , full_path: /repos/admin/
-	// fill param, full_path: /repos/admin/example
-	// /repos/:user/:repo/[tree]
-	// prev: 19, next: null, value: tree, full_path: /repos/admin/example/tree
 	if (!params) {
 		strcpy(full_path, path);
 		return full_path;
 	}
-	while (1) {
-		next = router_path_parse_key(next, key, &key_len);
-		if (!next) {
-			full_path[i++] = '/';
-			strcpy(full_path + i, prev);
-			break;
+	for (p = path; *p; ++p) {
+		if (*p != ':' || (p > path && *(p - 1) != '/')) {
+			full_path[i++] = *p;
+			continue;
 		}
-		value_len = next - key_len - prev - 2;
-		if (value_len > 0) {
-			strncpy(full_path + i, prev, value_len);
-			i += value_len;
-		} else {
-			full_path[i++] = '/';
+		for (key_len = 0; p[key_len + 1] && p[key_len + 1] != '/' &&
+				  key_len < sizeof(key) - 1;
+		     ++key_len) {
+			key[key_len] = p[key_len + 1];
 		}
-		full_path[i] = 0;
-		prev = next;
+		key[key_len] = 0;
+		p += key_len;
 		value = Dict_FetchValue(params, key);
 		if (!value) {
 			Logger_Error(
@@ -102,9 +89,10 @@ char *router_path_fill_params(const char *path, router_string_dict_t *params)
 		value_len = strlen(value);
 		full_path_len += value_len;
 		full_path = realloc(full_path, sizeof(char) * full_path_len);
-		strcpy(full_path + i, value);
+		memcpy(full_path + i, value, value_len);
 		i += value_len;
 	}
+	full_path[i] = 0;
 	return full_path;
 }
 
@@ -297,6 +285,30 @@ router_boolean_t router_is_same_route(const router_route_t *a,
 	return FALSE;
 }
 
+// Same as router_is_same_route(), but checks a normalized location so that
+// a navigation to the current route can be detected before matching.
+
+router_boolean_t router_location_is_same_route(
+    const router_location_t *location, const router_route_t *route)
+{
+	const char *hash = location->hash ? location->hash : "";
+
+	if (location->path) {
+		return router_path_compare(location->path, route->path) == 0 &&
+		       router_string_compare(hash, route->hash) == 0 &&
+		       router_string_dict_equal(location->query, route->query);
+	}
+	if (location->name && route->name) {
+		return strcmp(location->name, route->name) == 0 &&
+		       router_string_compare(hash, route->hash) == 0 &&
+		       router_string_dict_equal(location->query,
+						route->query) &&
+		       router_string_dict_equal(location->params,
+						route->params);
+	}
+	return FALSE;
+}
+
 // https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/src/util/route.js#L115
 
 router_boolean_t router_is_included_route(const router_route_t *current,
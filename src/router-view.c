@@ -1,17 +1,304 @@
 ﻿#include "router.h"
 #include "lcui-router-view.h"
+#include <LCUI/main.h>
+#include <LCUI/timer.h>
+
+#define ROUTER_VIEW_DESTROY_INTERVAL 16
+#define ROUTER_VIEW_PREFETCH_CONCURRENCY 2
+#define ROUTER_VIEW_PREFETCH_MEMORY (1024 * 1024)
+
+typedef struct RouterViewCacheItemRec_ {
+	size_t entry_id;
+	char *name;
+	size_t memory;
+	LCUI_Widget widget;
+	LinkedListNode node;
+} RouterViewCacheItemRec, *RouterViewCacheItem;
+
+typedef struct RouterViewCacheRec_ {
+	size_t max;
+	size_t max_memory;
+	size_t memory;
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	LinkedList items;
+} RouterViewCacheRec, *RouterViewCache;
+
+typedef struct RouterViewPrefetcherRec_ {
+	size_t concurrency;
+	LinkedList jobs;
+	RouterViewCacheRec cache;
+} RouterViewPrefetcherRec;
 
 typedef struct RouterViewRec_ {
 	size_t index;
+	size_t entry_id;
 	router_t *router;
 	router_watcher_t *watcher;
 	router_boolean_t keep_alive;
-	Dict *cache;
-	DictType cache_dict_type;
+	router_boolean_t outdated;
+	RouterViewCacheRec cache;
+	RouterViewCacheRec bfcache;
 	LCUI_Widget matched_widget;
 } RouterViewRec, *RouterView;
 
+typedef struct RouterViewPoolRec_ {
+	size_t max;
+	LinkedList widgets;
+	LCUI_WidgetFunction reset;
+} RouterViewPoolRec, *RouterViewPool;
+
+typedef struct RouterViewDestroyQueueRec_ {
+	int timer;
+	long budget;
+	LCUI_BOOL enabled;
+	LinkedList widgets;
+} RouterViewDestroyQueueRec;
+
 static LCUI_WidgetPrototype router_view_proto;
+static Dict *router_view_pools = NULL;
+static DictType router_view_pools_dict_type;
+static RouterViewDestroyQueueRec router_view_destroy_queue;
+static RouterViewPrefetcherRec router_view_prefetcher;
+
+// Queued widgets are destroyed one by one until the time budget of the
+// frame is used up. A subtree is never split up, a component may still
+// refer to its children when it is destroyed.
+
+static void RouterView_OnDestroyTimer(void *arg)
+{
+	int64_t start = LCUI_GetTime();
+	LinkedListNode *node;
+	RouterViewDestroyQueueRec *queue = &router_view_destroy_queue;
+
+	while (queue->widgets.length > 0) {
+		node = queue->widgets.head.next;
+		Widget_Destroy(node->data);
+		LinkedList_DeleteNode(&queue->widgets, node);
+		if (LCUI_GetTimeDelta(start) >= queue->budget) {
+			break;
+		}
+	}
+	if (queue->widgets.length < 1) {
+		LCUI_ClearTimer(queue->timer);
+		queue->timer = 0;
+	}
+}
+
+static void RouterView_DestroyWidget(LCUI_Widget widget)
+{
+	RouterViewDestroyQueueRec *queue = &router_view_destroy_queue;
+
+	if (!queue->enabled) {
+		Widget_Destroy(widget);
+		return;
+	}
+	Widget_Unlink(widget);
+	LinkedList_Append(&queue->widgets, widget);
+	if (!queue->timer) {
+		queue->timer = LCUI_SetInterval(ROUTER_VIEW_DESTROY_INTERVAL,
+						RouterView_OnDestroyTimer, NULL);
+	}
+}
+
+static void RouterViewPool_Clear(RouterViewPool pool)
+{
+	LinkedListNode *node;
+
+	while (pool->widgets.length > 0) {
+		node = pool->widgets.head.next;
+		Widget_Destroy(node->data);
+		LinkedList_DeleteNode(&pool->widgets, node);
+	}
+}
+
+static void RouterViewPool_Destroy(void *privdata, void *data)
+{
+	RouterViewPool pool = data;
+
+	RouterViewPool_Clear(pool);
+	free(pool);
+}
+
+static RouterViewPool RouterViewPool_Get(const char *component_name)
+{
+	if (!router_view_pools) {
+		return NULL;
+	}
+	return Dict_FetchValue(router_view_pools, component_name);
+}
+
+// Parked widgets are detached and have been reset, taking one is as good
+// as creating a new component.
+
+static LCUI_Widget RouterViewPool_Take(const char *component_name)
+{
+	LCUI_Widget widget;
+	LinkedListNode *node;
+	RouterViewPool pool;
+
+	pool = RouterViewPool_Get(component_name);
+	if (!pool || pool->widgets.length < 1) {
+		return NULL;
+	}
+	node = pool->widgets.tail.prev;
+	widget = node->data;
+	LinkedList_DeleteNode(&pool->widgets, node);
+	return widget;
+}
+
+// Widgets leaving a view go through here instead of being destroyed, so
+// that a component with a pool can be reused by the next navigation.
+
+static void RouterView_ReleaseWidget(LCUI_Widget widget)
+{
+	RouterViewPool pool;
+
+	pool = RouterViewPool_Get(widget->type);
+	if (!pool || pool->widgets.length >= pool->max) {
+		RouterView_DestroyWidget(widget);
+		return;
+	}
+	Widget_Unlink(widget);
+	if (pool->reset) {
+		pool->reset(widget);
+	}
+	LinkedList_Append(&pool->widgets, widget);
+}
+
+static void RouterViewCache_Init(RouterViewCache cache)
+{
+	cache->max = 0;
+	cache->max_memory = 0;
+	cache->memory = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+	LinkedList_Init(&cache->items);
+}
+
+static size_t RouterViewCache_EstimateMemory(LCUI_Widget w)
+{
+	size_t memory = sizeof(LCUI_WidgetRec);
+	LinkedListNode *node;
+
+	for (LinkedList_Each(node, &w->children)) {
+		memory += RouterViewCache_EstimateMemory(node->data);
+	}
+	return memory;
+}
+
+static void RouterViewCache_Remove(RouterViewCache cache,
+				   RouterViewCacheItem item)
+{
+	LinkedList_Unlink(&cache->items, &item->node);
+	cache->memory -= item->memory;
+	if (item->name) {
+		free(item->name);
+	}
+	free(item);
+}
+
+static router_boolean_t RouterViewCache_IsFull(RouterViewCache cache)
+{
+	return (cache->max > 0 && cache->items.length > cache->max) ||
+	       (cache->max_memory > 0 && cache->memory > cache->max_memory);
+}
+
+static void RouterViewCache_Trim(RouterViewCache cache)
+{
+	RouterViewCacheItem item;
+
+	while (cache->items.length > 0 && RouterViewCache_IsFull(cache)) {
+		item = cache->items.tail.prev->data;
+		RouterView_ReleaseWidget(item->widget);
+		RouterViewCache_Remove(cache, item);
+		cache->evictions++;
+	}
+}
+
+static void RouterViewCache_Clear(RouterViewCache cache)
+{
+	RouterViewCacheItem item;
+
+	while (cache->items.length > 0) {
+		item = cache->items.head.next->data;
+		Widget_Destroy(item->widget);
+		RouterViewCache_Remove(cache, item);
+	}
+}
+
+// The most recently used widget is kept at the head of the list, the
+// least recently used ones are destroyed while the cache is over budget.
+
+static void RouterViewCache_Put(RouterViewCache cache, size_t entry_id,
+				const char *name, LCUI_Widget widget)
+{
+	RouterViewCacheItem item;
+
+	item = malloc(sizeof(RouterViewCacheItemRec));
+	item->entry_id = entry_id;
+	item->name = name ? strdup(name) : NULL;
+	item->widget = widget;
+	item->memory = RouterViewCache_EstimateMemory(widget);
+	item->node.data = item;
+	item->node.prev = NULL;
+	item->node.next = NULL;
+	Widget_Unlink(widget);
+	LinkedList_Link(&cache->items, &cache->items.head, &item->node);
+	cache->memory += item->memory;
+	RouterViewCache_Trim(cache);
+}
+
+static LCUI_Widget RouterViewCache_Take(RouterViewCache cache,
+					size_t entry_id, const char *name)
+{
+	LCUI_Widget widget;
+	LinkedListNode *node;
+	RouterViewCacheItem item;
+
+	for (LinkedList_Each(node, &cache->items)) {
+		item = node->data;
+		if (item->entry_id != entry_id) {
+			continue;
+		}
+		if (name ? item->name && strcmp(item->name, name) == 0
+			 : !item->name) {
+			widget = item->widget;
+			RouterViewCache_Remove(cache, item);
+			cache->hits++;
+			return widget;
+		}
+	}
+	cache->misses++;
+	return NULL;
+}
+
+static router_boolean_t RouterViewCache_Has(RouterViewCache cache,
+					    const char *name)
+{
+	LinkedListNode *node;
+	RouterViewCacheItem item;
+
+	for (LinkedList_Each(node, &cache->items)) {
+		item = node->data;
+		if (item->name && strcmp(item->name, name) == 0) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static void RouterViewCache_GetStats(RouterViewCache cache,
+				     RouterViewCacheStats stats)
+{
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->evictions = cache->evictions;
+	stats->length = cache->items.length;
+	stats->memory = cache->memory;
+}
 
 static LCUI_Widget RouterView_GetMatched(LCUI_Widget w,
 					 const router_route_t *route)
@@ -20,7 +307,7 @@ static LCUI_Widget RouterView_GetMatched(LCUI_Widget w,
 	const char *component_name;
 	const router_route_record_t *record;
 	RouterView view;
-	LCUI_Widget component;
+	LCUI_Widget component = NULL;
 
 	view = Widget_GetData(w, router_view_proto);
 	name = Widget_GetAttribute(w, "name");
@@ -33,30 +320,184 @@ static LCUI_Widget RouterView_GetMatched(LCUI_Widget w,
 		name = "default";
 	}
 	component_name = router_route_record_get_component(record, name);
+	if (view->keep_alive && view->matched_widget &&
+	    strcmp(view->matched_widget->type, component_name) == 0) {
+		return view->matched_widget;
+	}
 	if (view->keep_alive) {
-		component = Dict_FetchValue(view->cache, component_name);
-		if (!component) {
-			component = LCUIWidget_New(component_name);
-			Dict_Add(view->cache, (void *)component_name,
-				 component);
-		}
-	} else {
+		component = RouterViewCache_Take(&view->cache, 0,
+						 component_name);
+	}
+	if (!component) {
+		component = RouterViewPool_Take(component_name);
+	}
+	if (!component) {
+		component = RouterViewCache_Take(&router_view_prefetcher.cache,
+						 0, component_name);
+	}
+	if (!component) {
 		component = LCUIWidget_New(component_name);
 	}
 	return component;
 }
 
+static LinkedListNode *RouterViewPrefetcher_FindJob(const char *name)
+{
+	LinkedListNode *node;
+
+	for (LinkedList_Each(node, &router_view_prefetcher.jobs)) {
+		if (strcmp(node->data, name) == 0) {
+			return node;
+		}
+	}
+	return NULL;
+}
+
+static void RouterViewPrefetcher_OnTask(void *arg1, void *arg2)
+{
+	const char *name = arg1;
+	LinkedListNode *node;
+	LCUI_Widget widget;
+
+	node = RouterViewPrefetcher_FindJob(name);
+	if (!node) {
+		return;
+	}
+	free(node->data);
+	LinkedList_DeleteNode(&router_view_prefetcher.jobs, node);
+	widget = LCUIWidget_New(name);
+	RouterViewCache_Put(&router_view_prefetcher.cache, 0, name, widget);
+}
+
+// Components are created in tasks run by the main loop, one per task, and
+// no more than `concurrency` of them may be waiting at the same time.
+
+static void RouterViewPrefetcher_Add(const char *name)
+{
+	LCUI_TaskRec task = { 0 };
+	RouterViewPool pool;
+	RouterViewPrefetcherRec *prefetcher = &router_view_prefetcher;
+
+	if (prefetcher->jobs.length >= prefetcher->concurrency ||
+	    RouterViewPrefetcher_FindJob(name) ||
+	    RouterViewCache_Has(&prefetcher->cache, name)) {
+		return;
+	}
+	pool = RouterViewPool_Get(name);
+	if (pool && pool->widgets.length > 0) {
+		return;
+	}
+	LinkedList_Append(&prefetcher->jobs, strdup(name));
+	task.func = RouterViewPrefetcher_OnTask;
+	task.arg[0] = strdup(name);
+	task.destroy_arg[0] = free;
+	LCUI_PostTask(&task);
+}
+
+static void RouterViewPrefetcher_Clear(void)
+{
+	LinkedList_Clear(&router_view_prefetcher.jobs, free);
+	RouterViewCache_Clear(&router_view_prefetcher.cache);
+}
+
+static router_boolean_t RouterView_IsAttached(LCUI_Widget w)
+{
+	while (w->parent) {
+		w = w->parent;
+	}
+	return w == LCUIWidget_GetRoot();
+}
+
+// A keep-alive view caches its widgets by component name, otherwise the
+// back/forward cache keeps them by the history entry they were shown for.
+
+static void RouterView_CacheMatchedWidget(RouterView view)
+{
+	LCUI_Widget widget = view->matched_widget;
+
+	if (!widget) {
+		return;
+	}
+	view->matched_widget = NULL;
+	if (view->keep_alive) {
+		RouterViewCache_Put(&view->cache, 0, widget->type, widget);
+	} else if (view->bfcache.max > 0) {
+		RouterViewCache_Put(&view->bfcache, view->entry_id, NULL,
+				    widget);
+	} else {
+		RouterView_ReleaseWidget(widget);
+	}
+}
+
+static void RouterView_TriggerRouteUpdate(RouterView view,
+					  const router_route_t *to)
+{
+	LCUI_WidgetEventRec e;
+
+	if (!view->matched_widget) {
+		return;
+	}
+	LCUI_InitWidgetEvent(&e, "routeupdate");
+	e.cancel_bubble = TRUE;
+	Widget_TriggerEvent(view->matched_widget, &e, (void *)to);
+}
+
+static void RouterView_Empty(LCUI_Widget w)
+{
+	if (!router_view_destroy_queue.enabled) {
+		Widget_Empty(w);
+		return;
+	}
+	while (w->children.length > 0) {
+		RouterView_DestroyWidget(w->children.head.next->data);
+	}
+}
+
+// A view inside a detached subtree, such as one kept in the cache of its
+// parent view, is left as it is until it is attached again. If it is
+// attached back for the entry it was showing, it needs no update. When
+// the matched record at the depth of the view is unchanged, the component
+// is kept and only receives a "routeupdate" event.
+
 static void RouterView_OnRouteUpdate(void *w, const router_route_t *to,
 				     const router_route_t *from)
 {
+	size_t entry_id;
 	RouterView view;
+	LCUI_Widget widget = NULL;
 
 	view = Widget_GetData(w, router_view_proto);
-	if (view->matched_widget && view->keep_alive) {
-		Widget_Unlink(view->matched_widget);
+	if (!RouterView_IsAttached(w)) {
+		view->outdated = TRUE;
+		return;
+	}
+	entry_id = router_history_get_current_entry_id(
+	    router_get_history(view->router));
+	if (view->outdated && view->entry_id == entry_id) {
+		view->outdated = FALSE;
+		return;
 	}
-	view->matched_widget = RouterView_GetMatched(w, to);
-	Widget_Empty(w);
+	if (!view->outdated &&
+	    router_route_get_diverged_depth(to, from) > view->index) {
+		view->entry_id = entry_id;
+		RouterView_TriggerRouteUpdate(view, to);
+		return;
+	}
+	view->outdated = FALSE;
+	if (!view->keep_alive && view->bfcache.max > 0) {
+		widget = RouterViewCache_Take(&view->bfcache, entry_id, NULL);
+	}
+	if (!widget) {
+		widget = RouterView_GetMatched(w, to);
+	}
+	if (widget == view->matched_widget) {
+		view->entry_id = entry_id;
+		return;
+	}
+	RouterView_CacheMatchedWidget(view);
+	view->matched_widget = widget;
+	view->entry_id = entry_id;
+	RouterView_Empty(w);
 	Widget_Append(w, view->matched_widget);
 }
 
@@ -90,6 +531,8 @@ static void RouterView_OnReady(LCUI_Widget w, LCUI_WidgetEvent e, void *arg)
 	view->watcher = router_watch(router, RouterView_OnRouteUpdate, w);
 	view->router = router;
 	view->index = index;
+	view->entry_id =
+	    router_history_get_current_entry_id(router_get_history(router));
 	if (route) {
 		view->matched_widget = RouterView_GetMatched(w, route);
 		Widget_Append(w, view->matched_widget);
@@ -107,6 +550,189 @@ LCUI_Widget RouterView_GetMatchedWidget(LCUI_Widget w)
 	return view->matched_widget;
 }
 
+// Widgets of the component are parked in a pool of up to `max` instances
+// when they leave a view, `reset` is called on each of them before it is
+// parked so the component can restore its initial state.
+
+void RouterView_EnablePool(const char *component_name, size_t max,
+			   LCUI_WidgetFunction reset)
+{
+	RouterViewPool pool;
+
+	if (!router_view_pools) {
+		Dict_InitStringCopyKeyType(&router_view_pools_dict_type);
+		router_view_pools_dict_type.valDestructor =
+		    RouterViewPool_Destroy;
+		router_view_pools =
+		    Dict_Create(&router_view_pools_dict_type, NULL);
+	}
+	pool = RouterViewPool_Get(component_name);
+	if (!pool) {
+		pool = malloc(sizeof(RouterViewPoolRec));
+		LinkedList_Init(&pool->widgets);
+		Dict_Add(router_view_pools, (void *)component_name, pool);
+	}
+	pool->max = max;
+	pool->reset = reset;
+	while (pool->widgets.length > max) {
+		Widget_Destroy(LinkedList_Get(&pool->widgets, 0));
+		LinkedList_Delete(&pool->widgets, 0);
+	}
+}
+
+void RouterView_DisablePool(const char *component_name)
+{
+	if (router_view_pools) {
+		Dict_Delete(router_view_pools, component_name);
+	}
+}
+
+void RouterView_ClearPools(void)
+{
+	RouterViewPrefetcher_Clear();
+	if (router_view_pools) {
+		Dict_Release(router_view_pools);
+		router_view_pools = NULL;
+	}
+}
+
+void RouterView_PrefetchRoute(const router_route_t *route)
+{
+	size_t i;
+	DictEntry *entry;
+	DictIterator *iter;
+	const router_route_record_t *record;
+
+	for (i = 0; i < route->matched_length; ++i) {
+		record = route->matched[i];
+		iter = Dict_GetIterator(record->components);
+		while ((entry = Dict_Next(iter))) {
+			RouterViewPrefetcher_Add(DictEntry_GetVal(entry));
+		}
+		Dict_ReleaseIterator(iter);
+	}
+}
+
+// Zero memory budget means no limit, the estimate is in bytes.
+
+void RouterView_SetPrefetchBudget(size_t concurrency, size_t max_memory)
+{
+	router_view_prefetcher.concurrency = concurrency;
+	router_view_prefetcher.cache.max_memory = max_memory;
+	RouterViewCache_Trim(&router_view_prefetcher.cache);
+}
+
+void RouterView_GetPrefetchStats(RouterViewCacheStats stats)
+{
+	RouterViewCache_GetStats(&router_view_prefetcher.cache, stats);
+}
+
+// With deferred destruction, widgets leaving a view are detached at once
+// and destroyed in later frames, spending at most `budget` milliseconds
+// per frame.
+
+void RouterView_SetDeferredDestroy(LCUI_BOOL enabled, long budget)
+{
+	router_view_destroy_queue.enabled = enabled;
+	router_view_destroy_queue.budget = budget;
+	if (!enabled) {
+		RouterView_FlushDestroyQueue();
+	}
+}
+
+size_t RouterView_FlushDestroyQueue(void)
+{
+	size_t count;
+	LinkedListNode *node;
+	RouterViewDestroyQueueRec *queue = &router_view_destroy_queue;
+
+	count = queue->widgets.length;
+	while (queue->widgets.length > 0) {
+		node = queue->widgets.head.next;
+		Widget_Destroy(node->data);
+		LinkedList_DeleteNode(&queue->widgets, node);
+	}
+	if (queue->timer) {
+		LCUI_ClearTimer(queue->timer);
+		queue->timer = 0;
+	}
+	return count;
+}
+
+void RouterView_SetKeepAlive(LCUI_Widget w, LCUI_BOOL keep_alive)
+{
+	RouterView view;
+
+	view = Widget_GetData(w, router_view_proto);
+	view->keep_alive = keep_alive;
+	if (!keep_alive) {
+		RouterViewCache_Clear(&view->cache);
+	}
+}
+
+// Zero means no limit, the memory budget is an estimate in bytes.
+
+void RouterView_SetKeepAliveLimit(LCUI_Widget w, size_t max,
+				  size_t max_memory)
+{
+	RouterView view;
+
+	view = Widget_GetData(w, router_view_proto);
+	view->cache.max = max;
+	view->cache.max_memory = max_memory;
+	RouterViewCache_Trim(&view->cache);
+}
+
+void RouterView_GetKeepAliveStats(LCUI_Widget w, RouterViewCacheStats stats)
+{
+	RouterView view;
+
+	view = Widget_GetData(w, router_view_proto);
+	RouterViewCache_GetStats(&view->cache, stats);
+}
+
+void RouterView_SetBFCacheSize(LCUI_Widget w, size_t size)
+{
+	RouterView view;
+
+	view = Widget_GetData(w, router_view_proto);
+	view->bfcache.max = size;
+	if (size > 0) {
+		RouterViewCache_Trim(&view->bfcache);
+	} else {
+		RouterViewCache_Clear(&view->bfcache);
+	}
+}
+
+void RouterView_GetBFCacheStats(LCUI_Widget w, RouterViewCacheStats stats)
+{
+	RouterView view;
+
+	view = Widget_GetData(w, router_view_proto);
+	RouterViewCache_GetStats(&view->bfcache, stats);
+}
+
+static void RouterView_OnSetAttribute(LCUI_Widget w, const char *name,
+				      const char *value)
+{
+	RouterView view;
+
+	view = Widget_GetData(w, router_view_proto);
+	if (strcmp(name, "keep-alive") == 0) {
+		RouterView_SetKeepAlive(w, strcmp(value, "false") != 0);
+	} else if (strcmp(name, "max") == 0) {
+		RouterView_SetKeepAliveLimit(w, strtoul(value, NULL, 10),
+					     view->cache.max_memory);
+	} else if (strcmp(name, "max-memory") == 0) {
+		RouterView_SetKeepAliveLimit(w, view->cache.max,
+					     strtoul(value, NULL, 10));
+	} else if (strcmp(name, "bfcache") == 0) {
+		RouterView_SetBFCacheSize(w, strtoul(value, NULL, 10));
+	} else {
+		router_view_proto->proto->setattr(w, name, value);
+	}
+}
+
 static void RouterView_OnInit(LCUI_Widget w)
 {
 	RouterView view;
@@ -114,9 +740,12 @@ static void RouterView_OnInit(LCUI_Widget w)
 	view = Widget_AddData(w, router_view_proto, sizeof(RouterViewRec));
 	view->router = NULL;
 	view->watcher = NULL;
-	Dict_InitStringCopyKeyType(&view->cache_dict_type);
-	view->cache = Dict_Create(&view->cache_dict_type, NULL);
+	view->entry_id = 0;
+	view->outdated = FALSE;
 	view->keep_alive = FALSE;
+	view->matched_widget = NULL;
+	RouterViewCache_Init(&view->cache);
+	RouterViewCache_Init(&view->bfcache);
 	Widget_BindEvent(w, "ready", RouterView_OnReady, NULL, NULL);
 }
 
@@ -128,15 +757,24 @@ static void RouterView_OnDestroy(LCUI_Widget w)
 	if (view->router) {
 		router_unwatch(view->router, view->watcher);
 	}
-	Dict_Release(view->cache);
-	view->cache = NULL;
+	RouterViewCache_Clear(&view->cache);
+	RouterViewCache_Clear(&view->bfcache);
 	view->watcher = NULL;
 	view->router = NULL;
 }
 
 void UI_InitRouterView(void)
 {
+	router_view_destroy_queue.timer = 0;
+	router_view_destroy_queue.budget = 0;
+	router_view_destroy_queue.enabled = FALSE;
+	LinkedList_Init(&router_view_destroy_queue.widgets);
+	router_view_prefetcher.concurrency = ROUTER_VIEW_PREFETCH_CONCURRENCY;
+	LinkedList_Init(&router_view_prefetcher.jobs);
+	RouterViewCache_Init(&router_view_prefetcher.cache);
+	router_view_prefetcher.cache.max_memory = ROUTER_VIEW_PREFETCH_MEMORY;
 	router_view_proto = LCUIWidget_NewPrototype("router-view", NULL);
 	router_view_proto->init = RouterView_OnInit;
+	router_view_proto->setattr = RouterView_OnSetAttribute;
 	router_view_proto->destroy = RouterView_OnDestroy;
 }
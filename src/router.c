@@ -1,7 +1,20 @@
 ﻿#include "router.h"
+#include <LCUI/thread.h>
+
+// The routers dict is created once by the first caller and never released,
+// the mutex lets other threads look routers up by name.
 
 static Dict *routers = NULL;
 static DictType routers_dict_type;
+static LCUI_Mutex routers_mutex;
+static router_once_t routers_once = ROUTER_ONCE_INIT;
+
+static void router_init_routers(void)
+{
+	Dict_InitStringKeyType(&routers_dict_type);
+	LCUIMutex_Init(&routers_mutex);
+	routers = Dict_Create(&routers_dict_type, NULL);
+}
 
 router_t *router_create(const char *name)
 {
@@ -12,34 +25,57 @@ router_t *router_create(const char *name)
 		name = "default";
 	}
 	router->name = strdup(name);
+	router->routes_version = 0;
+	router->same_route_reload = FALSE;
+	router->guards.length = 0;
+	router->guards.items = NULL;
+	router->navigation_id = 0;
+	router->navigation_loader = NULL;
+	router->navigation_loader_data = NULL;
+	LinkedList_Init(&router->navigations);
+	router_request_queue_init(&router->requests);
+	router->requests_scheduled = 0;
 	router->link_active_class = strdup("router-link-active");
 	router->link_exact_active_class = strdup("router-link-exact-active");
 	router->matcher = router_matcher_create();
 	router->history = router_history_create();
-	if (!routers) {
-		Dict_InitStringKeyType(&routers_dict_type);
-		routers = Dict_Create(&routers_dict_type, NULL);
-	}
+	router->history->router = router;
+	router->history->matcher = router->matcher;
+	router_once(&routers_once, router_init_routers);
+	LCUIMutex_Lock(&routers_mutex);
 	Dict_Add(routers, router->name, router);
+	LCUIMutex_Unlock(&routers_mutex);
 	return router;
 }
 
 void router_destroy(router_t *router)
 {
+	size_t count;
+
+	LCUIMutex_Lock(&routers_mutex);
 	Dict_Delete(routers, router->name);
+	count = Dict_Size(routers);
+	LCUIMutex_Unlock(&routers_mutex);
+	router_detach_navigations(router);
+	router_request_queue_clear(&router->requests);
 	router_mem_free(router->name);
 	router_mem_free(router->link_active_class);
 	router_mem_free(router->link_exact_active_class);
+	router_mem_free(router->guards.items);
 	router_matcher_destroy(router->matcher);
 	router_history_destroy(router->history);
 	router->matcher = NULL;
 	free(router);
+	if (count < 1) {
+		router_clear_pools();
+	}
 }
 
 router_route_record_t *router_add_route_record(
     router_t *router, const router_config_t *config,
     const router_route_record_t *parent)
 {
+	router->routes_version++;
 	return router_matcher_add_route_record(router->matcher, config, parent);
 }
 
@@ -54,7 +90,52 @@ router_route_t *router_match(router_t *router,
 router_route_record_t *router_get_matched_route_record(router_t *router,
 						       size_t index)
 {
-	return LinkedList_Get(&router->history->current->matched, index);
+	return (router_route_record_t *)router_route_get_matched_record(
+	    router->history->current, index);
+}
+
+const router_route_record_t *router_match_record(router_t *router,
+						 const char *path,
+						 router_string_dict_t *params)
+{
+	return router_matcher_match_record(router->matcher, path, params);
+}
+
+size_t router_match_many(router_t *router, const char **paths, size_t count,
+			 router_match_result_t *results)
+{
+	return router_matcher_match_many(router->matcher, paths, count,
+					 results);
+}
+
+// Matches a full path into a caller-owned result without creating a route.
+// The query and hash are cut off in the scratch buffer, so the heap is only
+// used when params are captured into out->params.
+
+const router_route_record_t *router_match_into(router_t *router,
+					       const char *full_path,
+					       router_match_result_t *out,
+					       char *scratch,
+					       size_t scratch_size)
+{
+	const char *path = full_path;
+	size_t len = strcspn(full_path, "?#");
+
+	out->record = NULL;
+	if (full_path[len]) {
+		if (len >= scratch_size) {
+			return NULL;
+		}
+		memcpy(scratch, full_path, len);
+		scratch[len] = 0;
+		path = scratch;
+	}
+	if (out->params && Dict_Size(out->params) > 0) {
+		router_string_dict_clear(out->params);
+	}
+	out->record =
+	    router_matcher_match_record(router->matcher, path, out->params);
+	return out->record;
 }
 
 router_history_t *router_get_history(router_t *router)
@@ -68,11 +149,163 @@ router_watcher_t *router_watch(router_t *router, router_callback_t callback,
 	return router_history_watch(router->history, callback, data);
 }
 
+router_watcher_t *router_watch_path(router_t *router, const char *path_prefix,
+				    router_callback_t callback, void *data)
+{
+	return router_history_watch_path(router->history, path_prefix,
+					 callback, data);
+}
+
+router_watcher_t *router_watch_name(router_t *router, const char *name,
+				    router_callback_t callback, void *data)
+{
+	return router_history_watch_name(router->history, name, callback,
+					 data);
+}
+
+router_watcher_t *router_watch_record(router_t *router,
+				      const router_route_record_t *record,
+				      router_callback_t callback, void *data)
+{
+	return router_history_watch_record(router->history, record, callback,
+					   data);
+}
+
 void router_unwatch(router_t *router, router_watcher_t *watcher)
 {
 	router_history_unwatch(router->history, watcher);
 }
 
+// A normalized location whose path equals the current path can only differ in
+// the query or hash, so the current matched records and params are reused
+// unless the route table changed since the current route was matched.
+
+static router_route_t *router_match_normalized(
+    router_t *router, const router_location_t *location)
+{
+	router_route_t *route;
+	const router_route_t *current = router->history->current;
+
+	if (current && !location->name && location->path &&
+	    current->matched_length > 0 &&
+	    current->routes_version == router->routes_version &&
+	    strcmp(location->path, current->path) == 0) {
+		return router_route_create_sibling(current, location);
+	}
+	route = router_match(router, location, current);
+	route->routes_version = router->routes_version;
+	return route;
+}
+
+static router_guard_result_t router_run_guard_range(
+    const router_guard_entry_t *entries, size_t start, size_t end,
+    const router_route_t *to, const router_route_t *from,
+    router_location_t **redirect)
+{
+	size_t i;
+	router_guard_result_t result;
+
+	for (i = start; i < end; ++i) {
+		result = entries[i].guard(entries[i].data, to, from, redirect);
+		if (result != ROUTER_GUARD_NEXT) {
+			return result;
+		}
+	}
+	return ROUTER_GUARD_NEXT;
+}
+
+// Runs the leave guards of the records being left, the global guards and
+// the enter guards of the records being entered, in that order, like the
+// beforeRouteLeave, beforeEach and beforeEnter guards of vue-router.
+
+static router_guard_result_t router_run_guards(router_t *router,
+					       const router_route_t *to,
+					       router_location_t **redirect)
+{
+	size_t depth;
+	router_guard_result_t result;
+	const router_route_record_t *record;
+	const router_route_t *from = router->history->current;
+
+	depth = router_route_get_diverged_depth(to, from);
+	if (from && from->matched_length > depth) {
+		record = from->matched[from->matched_length - 1];
+		router_route_record_compile_guards(record);
+		if (record->leave_ends) {
+			result = router_run_guard_range(
+			    record->leave_chain, 0, record->leave_ends[depth],
+			    to, from, redirect);
+			if (result != ROUTER_GUARD_NEXT) {
+				return result;
+			}
+		}
+	}
+	result = router_run_guard_range(router->guards.items, 0,
+					router->guards.length, to, from,
+					redirect);
+	if (result != ROUTER_GUARD_NEXT) {
+		return result;
+	}
+	if (to->matched_length > depth) {
+		record = to->matched[to->matched_length - 1];
+		router_route_record_compile_guards(record);
+		if (record->enter_offsets) {
+			result = router_run_guard_range(
+			    record->enter_chain, record->enter_offsets[depth],
+			    record->enter_offsets[record->depth], to, from,
+			    redirect);
+		}
+	}
+	return result;
+}
+
+// Returns the route the navigation should go to after running the guards,
+// or NULL if it was aborted. The given route is consumed.
+
+router_route_t *router_guard_route(router_t *router, router_route_t *route)
+{
+	size_t redirects = 0;
+	router_location_t *redirect;
+	router_location_t *normalized;
+
+	while (route) {
+		redirect = NULL;
+		switch (router_run_guards(router, route, &redirect)) {
+		case ROUTER_GUARD_NEXT:
+			return route;
+		case ROUTER_GUARD_REDIRECT:
+			router_route_unref(route);
+			route = NULL;
+			if (!redirect) {
+				break;
+			}
+			if (++redirects > ROUTER_MAX_REDIRECTS) {
+				Logger_Warning("[router] too many redirects "
+					       "from navigation guards\n");
+				break;
+			}
+			normalized = router_location_normalize(
+			    redirect, router->history->current, FALSE);
+			route = router_match_normalized(router, normalized);
+			router_location_destroy(normalized);
+			break;
+		default:
+			router_route_unref(route);
+			route = NULL;
+			break;
+		}
+		if (redirect) {
+			router_location_destroy(redirect);
+		}
+	}
+	return NULL;
+}
+
+void router_before_each(router_t *router, router_guard_t guard, void *data)
+{
+	router_guard_list_add(&router->guards, guard, data);
+}
+
 // https://github.com/vuejs/vue-router/blob/65de048ee9f0ebf899ae99c82b71ad397727e55d/dist/vue-router.esm.js#L2827
 
 router_resolved_t *router_resolve(router_t *router, router_location_t *location,
@@ -85,7 +318,7 @@ router_resolved_t *router_resolve(router_t *router, router_location_t *location,
 	resolved = malloc(sizeof(router_resolved_t));
 	resolved->location =
 	    router_location_normalize(location, current, append);
-	resolved->route = router_match(router, resolved->location, current);
+	resolved->route = router_match_normalized(router, resolved->location);
 	return resolved;
 }
 
@@ -103,7 +336,7 @@ void router_resolved_destroy(router_resolved_t *resolved)
 {
 	router_location_destroy(resolved->location);
 	if (resolved->route) {
-		router_route_destroy(resolved->route);
+		router_route_unref(resolved->route);
 	}
 	free(resolved);
 }
@@ -113,49 +346,133 @@ const router_route_t *router_get_current_route(router_t *router)
 	return router->history->current;
 }
 
+// Pushing the current route again does not create a history entry, it is
+// ignored or, if enabled, reported to the watchers as a reload. Either way
+// pending asynchronous navigations are cancelled.
+
 void router_push(router_t *router, router_location_t *location)
 {
-	router_resolved_t *resolved;
+	router_route_t *route;
+	router_location_t *normalized;
+	router_history_t *history = router->history;
 
-	resolved = router_resolve(router, location, FALSE);
-	router_history_push(router->history, resolved->route);
-	resolved->route = NULL;
-	router_resolved_destroy(resolved);
+	router_cancel_navigations(router);
+	normalized =
+	    router_location_normalize(location, history->current, FALSE);
+	if (history->current &&
+	    router_location_is_same_route(normalized, history->current)) {
+		router_location_destroy(normalized);
+		if (router->same_route_reload) {
+			router_history_reload(history);
+		}
+		return;
+	}
+	route = router_match_normalized(router, normalized);
+	router_location_destroy(normalized);
+	route = router_guard_route(router, route);
+	if (!route) {
+		return;
+	}
+	if (history->current && router_is_same_route(route, history->current)) {
+		router_route_unref(route);
+		return;
+	}
+	router_history_push(history, route);
+}
+
+void router_set_same_route_reload(router_t *router, router_boolean_t enabled)
+{
+	router->same_route_reload = enabled;
 }
 
 void router_replace(router_t *router, router_location_t *location)
 {
+	router_route_t *route;
 	router_resolved_t *resolved;
 
+	router_cancel_navigations(router);
 	resolved = router_resolve(router, location, FALSE);
-	router_history_replace(router->history, resolved->route);
+	route = router_guard_route(router, resolved->route);
 	resolved->route = NULL;
 	router_resolved_destroy(resolved);
+	if (route) {
+		router_history_replace(router->history, route);
+	}
 }
 
+// Moving through the history cancels pending asynchronous navigations, so
+// a late commit can not undo the move. The move runs the same guards as a
+// push: an aborted move keeps the current entry and a redirected one
+// pushes the redirect target instead.
+
 void router_go(router_t *router, int delta)
 {
-	router_history_go(router->history, delta);
+	router_route_t *to;
+	router_route_t *route;
+	router_history_t *history = router->history;
+
+	router_cancel_navigations(router);
+	to = router_history_peek(history, delta);
+	if (!to) {
+		router_history_go(history, delta);
+		return;
+	}
+	route = router_guard_route(router, router_route_ref(to));
+	if (route == to) {
+		router_route_unref(route);
+		router_history_go(history, delta);
+	} else if (route) {
+		if (history->current &&
+		    router_is_same_route(route, history->current)) {
+			router_route_unref(route);
+		} else {
+			router_history_push(history, route);
+		}
+	}
+	router_route_unref(to);
 }
 
 void router_back(router_t *router)
 {
-	router_history_go(router->history, -1);
+	router_go(router, -1);
 }
 
 void router_forward(router_t *router)
 {
-	router_history_go(router->history, 1);
+	router_go(router, 1);
+}
+
+// Navigations between router_begin_batch() and router_commit() notify the
+// watchers once, with collapse all pushes of the batch share one entry.
+
+void router_begin_batch(router_t *router, router_boolean_t collapse)
+{
+	router_history_begin_batch(router->history, collapse);
+}
+
+void router_commit(router_t *router)
+{
+	router_history_commit(router->history);
+}
+
+int router_save_history(router_t *router, FILE *fp)
+{
+	return router_history_save(router->history, fp);
+}
+
+int router_restore_history(router_t *router, FILE *fp)
+{
+	return router_history_restore(router->history, router->matcher, fp);
 }
 
 router_t *router_get_by_name(const char *name)
 {
 	router_t *router;
 
-	if (!routers) {
-		return NULL;
-	}
+	router_once(&routers_once, router_init_routers);
+	LCUIMutex_Lock(&routers_mutex);
 	router = Dict_FetchValue(routers, name);
+	LCUIMutex_Unlock(&routers_mutex);
 	if (router) {
 		return router;
 	}
@@ -163,6 +480,13 @@ router_t *router_get_by_name(const char *name)
 	return NULL;
 }
 
+void router_clear_pools(void)
+{
+	router_route_pool_clear();
+	router_location_pool_clear();
+	router_string_dict_pool_clear();
+}
+
 const char *router_get_version(void)
 {
 	return LCUI_ROUTER_VERSION;
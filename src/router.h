@@ -4,10 +4,60 @@
 #include <string.h>
 #include <stdlib.h>
 #include <LCUI.h>
+#include <LCUI/thread.h>
 #include "lcui-router.h"
 
 #ifdef _WIN32
 #pragma warning(disable: 4996)
+#include <intrin.h>
+#define router_atomic_load_ptr(ptr) \
+	_InterlockedCompareExchangePointer((void *volatile *)(ptr), NULL, NULL)
+#define router_atomic_exchange_ptr(ptr, value) \
+	_InterlockedExchangePointer((void *volatile *)(ptr), value)
+#define router_atomic_store_ptr(ptr, value) \
+	_InterlockedExchangePointer((void *volatile *)(ptr), value)
+#define router_atomic_load(ptr) _InterlockedCompareExchange(ptr, 0, 0)
+#define router_atomic_exchange(ptr, value) _InterlockedExchange(ptr, value)
+#define router_atomic_fetch_add(ptr, value) _InterlockedExchangeAdd(ptr, value)
+#define router_atomic_increment(ptr) _InterlockedIncrement(ptr)
+#define router_atomic_decrement(ptr) _InterlockedDecrement(ptr)
+#define router_atomic_compare_exchange(ptr, expected, value) \
+	_InterlockedCompareExchange(ptr, value, expected)
+#else
+#define router_atomic_load_ptr(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define router_atomic_exchange_ptr(ptr, value) \
+	__atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST)
+#define router_atomic_store_ptr(ptr, value) \
+	__atomic_store_n(ptr, value, __ATOMIC_SEQ_CST)
+#define router_atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define router_atomic_exchange(ptr, value) \
+	__atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST)
+#define router_atomic_fetch_add(ptr, value) \
+	__atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST)
+#define router_atomic_increment(ptr) \
+	__atomic_add_fetch(ptr, 1, __ATOMIC_SEQ_CST)
+#define router_atomic_decrement(ptr) \
+	__atomic_sub_fetch(ptr, 1, __ATOMIC_SEQ_CST)
+#define router_atomic_compare_exchange(ptr, expected, value) \
+	__sync_val_compare_and_swap(ptr, expected, value)
+#endif
+
+#define ROUTER_HISTORY_FILE_MAGIC "lcui-router-history"
+#define ROUTER_HISTORY_FILE_VERSION 2
+
+#define ROUTER_MAX_REDIRECTS 16
+#define ROUTER_MATCH_CHUNK_SIZE 64
+
+#ifndef ROUTER_MATCH_PARALLEL_THRESHOLD
+#define ROUTER_MATCH_PARALLEL_THRESHOLD 1024
+#endif
+
+#ifndef ROUTER_MATCH_MAX_THREADS
+#define ROUTER_MATCH_MAX_THREADS 4
+#endif
+
+#ifndef ROUTER_POOL_CAPACITY
+#define ROUTER_POOL_CAPACITY 64
 #endif
 
 #define router_mem_free(ptr)       \
@@ -18,6 +68,28 @@
 		ptr = NULL;        \
 	} while (0)
 
+// Runs a function exactly once, other callers wait until it has returned.
+
+typedef volatile long router_once_t;
+
+#define ROUTER_ONCE_INIT 0
+
+// Pools are shared by all threads, take and put hold a spin lock because
+// the critical sections are only a few instructions long.
+
+typedef struct router_pool_t {
+	void **items;
+	size_t length;
+	size_t capacity;
+	size_t hits;
+	size_t misses;
+	void (*destroy)(void *);
+	volatile long lock;
+} router_pool_t;
+
+#define ROUTER_POOL_INIT(DESTROY) \
+	{ NULL, 0, ROUTER_POOL_CAPACITY, 0, 0, DESTROY, 0 }
+
 struct router_location_t {
 	char *name;
 	char *path;
@@ -28,43 +100,160 @@ struct router_location_t {
 };
 
 struct router_route_t {
+	size_t refs;
+	size_t routes_version;
 	char *name;
 	char *path;
 	char *full_path;
 	char *hash;
 	router_string_dict_t *query;
 	router_string_dict_t *params;
-	router_linkedlist_t matched;
+	size_t matched_length;
+	size_t matched_capacity;
+	const router_route_record_t **matched;
 };
 
+typedef struct router_guard_entry_t {
+	router_guard_t guard;
+	void *data;
+} router_guard_entry_t;
+
+typedef struct router_guard_list_t {
+	size_t length;
+	router_guard_entry_t *items;
+} router_guard_list_t;
+
 struct router_route_record_t {
 	char *name;
 	char *path;
+	size_t depth;
 	const router_route_record_t *parent;
+	const router_route_record_t **matched;
 	router_string_dict_t *components;
 	router_linkedlist_node_t node;
+
+	// redirect chains are compiled into the final target on registration,
+	// redirect_path is the final path in terms of the params of this record
+	char *redirect;
+	char *redirect_path;
+	const router_route_record_t *redirect_record;
+	const router_route_record_t *alias_of;
+
+	router_guard_list_t enter_guards;
+	router_guard_list_t leave_guards;
+
+	// guards of the whole matched chain, compiled on demand
+	size_t guards_version;
+	router_guard_entry_t *enter_chain;
+	size_t *enter_offsets;
+	router_guard_entry_t *leave_chain;
+	size_t *leave_ends;
 };
 
+typedef struct router_history_entry_t {
+	size_t id;
+	router_route_t *route;
+	char *full_path;
+	const router_route_record_t *record;
+	router_linkedlist_node_t node;
+} router_history_entry_t;
+
 struct router_history_t {
 	int index;
+	size_t entry_id;
+	size_t current_entry_id;
+	size_t max_materialized;
+	int window_begin;
+	int window_end;
+	router_t *router;
+	router_matcher_t *matcher;
 	router_route_t *current;
-	router_linkedlist_t routes;
+	router_linkedlist_t entries;
 	router_linkedlist_t watchers;
+	router_linkedlist_t removed_watchers;
+	Dict *path_watchers;
+	Dict *name_watchers;
+	Dict *record_watchers;
+	DictType string_watchers_dict_type;
+	DictType pointer_watchers_dict_type;
+	size_t watcher_id;
+	size_t dispatch_stamp;
+	int dispatching;
+	router_watcher_t **dispatch_buffer;
+	size_t dispatch_capacity;
+	int batch_depth;
+	router_boolean_t batch_collapse;
+	router_boolean_t batch_pushed;
+	router_route_t *batch_from;
 };
 
 struct router_config_t {
 	char *name;
 	char *path;
+	char *redirect;
+	router_linkedlist_t aliases;
 	router_string_dict_t *components;
 };
 
+// An immutable snapshot of the path list in match order. Readers on any
+// thread use the published table, the UI thread replaces it on every
+// registration and frees retired tables once no reader is active.
+
+typedef struct router_route_table_t {
+	size_t length;
+	const router_route_record_t **records;
+} router_route_table_t;
+
+typedef struct router_match_job_t {
+	const router_route_table_t *table;
+	const char **paths;
+	router_match_result_t *results;
+	size_t count;
+	volatile long next;
+	volatile long matched;
+} router_match_job_t;
+
+// Threads for large match batches, started on the first batch and kept
+// until the matcher is destroyed. One batch uses them at a time, a batch
+// that finds them busy is matched on the calling thread only.
+
+typedef struct router_match_workers_t {
+	LCUI_Mutex mutex;
+	LCUI_Cond job_posted;
+	LCUI_Cond job_done;
+	LCUI_Thread threads[ROUTER_MATCH_MAX_THREADS];
+	size_t length;
+	size_t active;
+	size_t job_id;
+	router_match_job_t *job;
+	router_boolean_t busy;
+	router_boolean_t exiting;
+} router_match_workers_t;
+
 struct router_matcher_t {
 	Dict *name_map;
 	Dict *path_map;
 	router_linkedlist_t path_list;
+	router_route_table_t *table;
+	router_linkedlist_t retired_tables;
+	volatile long readers;
+	router_match_workers_t workers;
 };
 
+typedef enum router_watcher_filter_t {
+	ROUTER_WATCHER_FILTER_NONE,
+	ROUTER_WATCHER_FILTER_PATH,
+	ROUTER_WATCHER_FILTER_NAME,
+	ROUTER_WATCHER_FILTER_RECORD
+} router_watcher_filter_t;
+
 struct router_watcher_t {
+	size_t id;
+	size_t stamp;
+	router_watcher_filter_t filter;
+	const void *key;
+	router_linkedlist_t *bucket;
+	router_boolean_t removed;
 	void *data;
 	router_callback_t callback;
 	router_linkedlist_node_t node;
@@ -75,12 +264,98 @@ struct router_resolved_t {
 	router_location_t *location;
 };
 
+struct router_navigation_t {
+	size_t id;
+	volatile long cancelled;
+	router_t *router;
+	router_route_t *route;
+	router_boolean_t replace;
+	router_boolean_t allowed;
+	router_navigation_callback_t callback;
+	void *data;
+	router_linkedlist_node_t node;
+};
+
+// Intrusive multi-producer single-consumer queue, any thread can push and
+// only the UI thread pops.
+
+typedef struct router_request_t {
+	struct router_request_t *next;
+	char *path;
+	router_boolean_t replace;
+} router_request_t;
+
+typedef struct router_request_queue_t {
+	router_request_t *head;
+	router_request_t *tail;
+	router_request_t stub;
+} router_request_queue_t;
+
 struct router_t {
 	char *name;
+	size_t routes_version;
+	router_boolean_t same_route_reload;
 	char *link_active_class;
 	char *link_exact_active_class;
 	router_matcher_t *matcher;
 	router_history_t *history;
+	router_guard_list_t guards;
+	size_t navigation_id;
+	router_linkedlist_t navigations;
+	router_navigation_loader_t navigation_loader;
+	void *navigation_loader_data;
+	router_request_queue_t requests;
+	volatile long requests_scheduled;
 };
 
+void router_once(router_once_t *once, void (*func)(void));
+
+void *router_pool_take(router_pool_t *pool);
+
+void router_pool_put(router_pool_t *pool, void *item);
+
+void router_pool_clear(router_pool_t *pool);
+
+void router_pool_get_stats(const router_pool_t *pool,
+			   router_pool_stats_t *stats);
+
+void router_string_dict_clear(router_string_dict_t *dict);
+
+char *router_path_stringify(const char *base_path, router_string_dict_t *query,
+			    const char *hash);
+
+router_route_t *router_route_create_from(const router_route_record_t *record,
+					 router_location_t *location);
+
+router_route_t *router_route_create_sibling(
+    const router_route_t *route, const router_location_t *location);
+
+router_boolean_t router_location_is_same_route(
+    const router_location_t *location, const router_route_t *route);
+
+router_boolean_t router_matcher_match_route(const router_route_record_t *record,
+					    const char *path, Dict *params);
+
+
+router_route_t *router_history_peek(router_history_t *history, int delta);
+
+void router_detach_navigations(router_t *router);
+
+void router_request_queue_init(router_request_queue_t *queue);
+
+void router_request_queue_clear(router_request_queue_t *queue);
+
+void router_guard_list_add(router_guard_list_t *list, router_guard_t guard,
+			   void *data);
+
+void router_route_record_compile_guards(const router_route_record_t *record);
+
+router_route_t *router_guard_route(router_t *router, router_route_t *route);
+
+void router_string_dict_pool_clear(void);
+
+void router_location_pool_clear(void);
+
+void router_route_pool_clear(void);
+
 #endif
@@ -1,7 +1,12 @@
 ﻿#include <stdio.h>
+
+#define ROUTER_LINK_IDLE_DELAY 0
+
 #include "../src/router.c"
 #include "../src/router-history.c"
 #include "../src/router-matcher.c"
+#include "../src/router-navigation.c"
+#include "../src/router-pool.c"
 #include "../src/router-config.c"
 #include "../src/router-location.c"
 #include "../src/router-route-record.c"
@@ -168,6 +173,7 @@ void test_router_location(void)
 
 void test_router_route(void)
 {
+	router_route_t *ref;
 	router_route_t *route;
 	router_location_t *location;
 	router_location_t *raw;
@@ -186,9 +192,38 @@ void test_router_route(void)
 	it_s("route.query.other", router_route_get_query(route, "other"), NULL);
 	it_s("route.hash", router_route_get_hash(route), "#pagination");
 	it_s("route.fullPath", router_route_get_full_path(route), full_path);
+	ref = router_route_ref(route);
+	it_b("route.ref() == route", ref == route, TRUE);
+	router_route_unref(route);
+	it_s("route.unref(), ref.path", router_route_get_path(ref),
+	     "/user/profile");
 	router_location_destroy(raw);
 	router_location_destroy(location);
-	router_route_destroy(route);
+	router_route_unref(ref);
+}
+
+typedef struct test_router_match_worker_t {
+	router_t *router;
+	const router_route_record_t *record;
+	int hits;
+} test_router_match_worker_t;
+
+static void test_router_match_worker(void *arg)
+{
+	int i;
+	router_string_dict_t *params;
+	const router_route_record_t *record;
+	test_router_match_worker_t *worker = arg;
+
+	for (i = 0; i < 1000; ++i) {
+		params = router_string_dict_create();
+		record = router_match_record(worker->router, "/users/root",
+					     params);
+		if (record && record->matched[0] == worker->record) {
+			worker->hits++;
+		}
+		router_string_dict_destroy(params);
+	}
 }
 
 void test_router_matcher(void)
@@ -201,6 +236,14 @@ void test_router_matcher(void)
 	router_location_t *location;
 	const router_route_record_t *record;
 	const char *str;
+	char path[32];
+	int i;
+	int hits;
+	LCUI_Thread thread;
+	test_router_match_worker_t worker = { 0 };
+	static char many_paths[2048][24];
+	static const char *many_path_refs[2048];
+	static router_match_result_t many_results[2048];
 
 	router = router_create(NULL);
 	config = router_config_create();
@@ -254,10 +297,53 @@ void test_router_matcher(void)
 
 	config = router_config_create();
 	router_config_set_path(config, "/about");
+	router_config_add_alias(config, "/info");
 	router_config_set_component(config, NULL, "about");
 	router_add_route_record(router, config, NULL);
 	router_config_destroy(config);
 
+	config = router_config_create();
+	router_config_set_path(config, "/u/:username");
+	router_config_set_redirect(config, "/people/:username");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
+	config = router_config_create();
+	router_config_set_path(config, "/people/:username");
+	router_config_set_redirect(config, "/users/:username");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
+	config = router_config_create();
+	router_config_set_path(config, "/old");
+	router_config_set_redirect(config, "/users/:id");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
+	config = router_config_create();
+	router_config_set_path(config, "/a/:x");
+	router_config_set_redirect(config, "/b/:x");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
+	config = router_config_create();
+	router_config_set_path(config, "/b/:y");
+	router_config_set_redirect(config, "/users/:y");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
+	config = router_config_create();
+	router_config_set_path(config, "/ping");
+	router_config_set_redirect(config, "/pong");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
+	config = router_config_create();
+	router_config_set_path(config, "/pong");
+	router_config_set_redirect(config, "/ping");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+
 	config = router_config_create();
 	router_config_set_path(config, "*");
 	router_config_set_component(config, NULL, "not-found");
@@ -310,6 +396,9 @@ void test_router_matcher(void)
 	it_s("match('/users/root/posts').route.matched[1].components.default",
 	     record ? router_route_record_get_component(record, NULL) : NULL,
 	     "user-posts");
+	record = router_route_get_matched_record(route, 2);
+	it_b("match('/users/root/posts').route.matched[2] == null", !record,
+	     TRUE);
 	router_resolved_destroy(resolved);
 
 	location = router_location_create(NULL, "/other/path/to/file");
@@ -340,6 +429,153 @@ void test_router_matcher(void)
 	     "path/to/file");
 	router_resolved_destroy(resolved);
 
+	location = router_location_create(NULL, "/u/root");
+	resolved = router_resolve(router, location, FALSE);
+	router_location_destroy(location);
+	route = router_resolved_get_route(resolved);
+	record = router_route_get_matched_record(route, 0);
+	it_s("match('/u/root').route.path", router_route_get_path(route),
+	     "/users/root");
+	it_b("match('/u/root').route.matched[0] == userShow",
+	     record == route_user_show, TRUE);
+	it_s("match('/u/root').route.params.username",
+	     router_route_get_param(route, "username"), "root");
+	router_resolved_destroy(resolved);
+
+	location = router_location_create(NULL, "/info");
+	resolved = router_resolve(router, location, FALSE);
+	router_location_destroy(location);
+	route = router_resolved_get_route(resolved);
+	record = router_route_get_matched_record(route, 0);
+	it_s("match('/info').route.path", router_route_get_path(route),
+	     "/info");
+	it_s("match('/info').route.matched[0].components.default",
+	     record ? router_route_record_get_component(record, NULL) : NULL,
+	     "about");
+	router_resolved_destroy(resolved);
+
+	location = router_location_create(NULL, "/ping");
+	resolved = router_resolve(router, location, FALSE);
+	router_location_destroy(location);
+	route = router_resolved_get_route(resolved);
+	it_s("match('/ping') with a redirect cycle, route.path",
+	     router_route_get_path(route), "/ping");
+	router_resolved_destroy(resolved);
+
+	location = router_location_create(NULL, "/old");
+	resolved = router_resolve(router, location, FALSE);
+	router_location_destroy(location);
+	route = router_resolved_get_route(resolved);
+	it_s("match('/old') with an unfillable redirect, route.path",
+	     router_route_get_path(route), "/old");
+	router_resolved_destroy(resolved);
+
+	location = router_location_create(NULL, "/a/1");
+	resolved = router_resolve(router, location, FALSE);
+	router_location_destroy(location);
+	route = router_resolved_get_route(resolved);
+	it_s("match('/a/1') with a chained redirect renaming a param, "
+	     "route.path",
+	     router_route_get_path(route), "/users/1");
+	it_s("match('/a/1') with a chained redirect renaming a param, "
+	     "route.params.username",
+	     router_route_get_param(route, "username"), "1");
+	router_resolved_destroy(resolved);
+
+	location = router_location_create(NULL, "/b/2");
+	resolved = router_resolve(router, location, FALSE);
+	router_location_destroy(location);
+	route = router_resolved_get_route(resolved);
+	it_s("match('/b/2').route.path", router_route_get_path(route),
+	     "/users/2");
+	router_resolved_destroy(resolved);
+
+	worker.router = router;
+	worker.record = route_user_show;
+	LCUIThread_Create(&thread, test_router_match_worker, &worker);
+	for (i = 0; i < 100; ++i) {
+		snprintf(path, sizeof(path), "/pages/%d", i);
+		config = router_config_create();
+		router_config_set_path(config, path);
+		router_add_route_record(router, config, NULL);
+		router_config_destroy(config);
+	}
+	LCUIThread_Join(thread, NULL);
+	it_i("matchRecord('/users/root') on a worker while adding routes, hits",
+	     worker.hits, 1000);
+
+	for (i = 0; i < 2048; ++i) {
+		snprintf(many_paths[i], 24, i % 2 ? "/pages/%d" : "/users/u%d",
+			 i);
+		many_path_refs[i] = many_paths[i];
+		many_results[i].params =
+		    i % 128 == 0 ? router_string_dict_create() : NULL;
+	}
+	it_i("matchMany(2048 paths), matched",
+	     (int)router_match_many(router, many_path_refs, 2048,
+				    many_results),
+	     2048);
+	for (hits = 0, i = 0; i < 2048; ++i) {
+		record = many_results[i].record;
+		if (record && record->matched[0] == route_user_show) {
+			hits++;
+		}
+	}
+	it_i("matchMany(2048 paths), '/users/:username' matches", hits, 1024);
+	it_s("matchMany(2048 paths), results[0].params.username",
+	     router_string_dict_get(many_results[0].params, "username"), "u0");
+	for (hits = 0, i = 0; i < 2048; i += 128) {
+		snprintf(path, sizeof(path), "u%d", i);
+		str = router_string_dict_get(many_results[i].params,
+					     "username");
+		if (str && strcmp(str, path) == 0) {
+			hits++;
+		}
+		router_string_dict_clear(many_results[i].params);
+	}
+	it_i("matchMany(2048 paths), params filled on every thread", hits, 16);
+	it_i("matchMany(2048 paths) again, matched",
+	     (int)router_match_many(router, many_path_refs, 2048,
+				    many_results),
+	     2048);
+	it_i("matchMany(2048 paths) again, worker threads are reused",
+	     (int)router->matcher->workers.length,
+	     ROUTER_MATCH_MAX_THREADS - 1);
+	for (i = 0; i < 2048; i += 128) {
+		router_string_dict_destroy(many_results[i].params);
+	}
+
+	record = router_matcher_test(router->matcher, "/users/root/posts");
+	it_s("matcher.test('/users/root/posts').components.default",
+	     record ? router_route_record_get_component(record, NULL) : NULL,
+	     "user-posts");
+	many_results[0].params = router_string_dict_create();
+	router_match_into(router, "/users/root?tab=posts#top", &many_results[0],
+			  path, sizeof(path));
+	record = many_results[0].record;
+	it_b("matchInto('/users/root?tab=posts#top').record.matched[0] == "
+	     "userShow",
+	     record && record->matched[0] == route_user_show, TRUE);
+	it_s("matchInto('/users/root?tab=posts#top').params.username",
+	     router_string_dict_get(many_results[0].params, "username"),
+	     "root");
+	router_match_into(router, "/about#team", &many_results[0], path,
+			  sizeof(path));
+	it_b("matchInto('/about#team') after '/users/root', params are empty",
+	     Dict_Size(many_results[0].params) == 0, TRUE);
+	router_match_into(router, "/users/admin", &many_results[0], path,
+			  sizeof(path));
+	it_s("matchInto('/users/admin') with reused params, params.username",
+	     router_string_dict_get(many_results[0].params, "username"),
+	     "admin");
+	router_string_dict_destroy(many_results[0].params);
+	many_results[0].params = NULL;
+	record = router_match_into(router, "/users/root?tab=posts",
+				   &many_results[0], path, sizeof(path));
+	it_b("matchInto('/users/root?tab=posts') without params, "
+	     "record.matched[0] == userShow",
+	     record && record->matched[0] == route_user_show, TRUE);
+
 	router_destroy(router);
 }
 
@@ -474,13 +710,104 @@ void test_router_utils(void)
 	free(str);
 }
 
+static void test_router_history_on_change(void *data, const router_route_t *to,
+					  const router_route_t *from)
+{
+	int *count = data;
+
+	(*count)++;
+}
+
+typedef struct test_router_watcher_t {
+	int changes;
+	router_t *router;
+	router_watcher_t *watcher;
+} test_router_watcher_t;
+
+static void test_router_history_on_change_once(void *data,
+					       const router_route_t *to,
+					       const router_route_t *from)
+{
+	test_router_watcher_t *w = data;
+
+	w->changes++;
+	router_unwatch(w->router, w->watcher);
+}
+
+static void test_router_on_navigation_done(void *data,
+					   router_navigation_status_t status)
+{
+	int *result = data;
+
+	*result = status;
+}
+
+static void test_router_navigation_loader(void *data,
+					  router_navigation_t *navigation)
+{
+	router_navigation_t **navigations = data;
+
+	navigations[navigations[0] ? 1 : 0] = navigation;
+}
+
+static void test_router_push_worker(void *arg)
+{
+	router_t *router = arg;
+
+	router_push_async(router, "/foo/bar");
+	router_push_async(router, "/foo?tab=1");
+	router_push_async(router, "/foo/bar?tab=2");
+}
+
+typedef struct test_router_guard_t {
+	int calls;
+	router_guard_result_t result;
+	const char *redirect;
+} test_router_guard_t;
+
+static router_guard_result_t test_router_guard(void *data,
+					       const router_route_t *to,
+					       const router_route_t *from,
+					       router_location_t **redirect)
+{
+	test_router_guard_t *guard = data;
+
+	guard->calls++;
+	if (guard->redirect) {
+		*redirect = router_location_create(NULL, guard->redirect);
+	}
+	return guard->result;
+}
+
 void test_router_history(void)
 {
+	FILE *fp;
+	int changes = 0;
+	int i;
 	router_t *router;
+	router_t *other;
 	router_config_t *config;
 	router_location_t *location;
 	router_history_t *history;
 	const router_route_t *route;
+	router_pool_stats_t route_stats;
+	router_pool_stats_t location_stats;
+	router_pool_stats_t dict_stats;
+	router_pool_stats_t stats;
+	router_history_entry_t *entry;
+	int path_changes = 0;
+	int record_changes = 0;
+	int first_status = -1;
+	int second_status = -1;
+	router_navigation_t *navigations[2] = { NULL, NULL };
+	test_router_guard_t leave_guard = { 0, ROUTER_GUARD_ABORT, NULL };
+	test_router_guard_t enter_guard = { 0, ROUTER_GUARD_REDIRECT, "/foo" };
+	test_router_guard_t global_guard = { 0, ROUTER_GUARD_NEXT, NULL };
+	LCUI_Thread thread;
+	test_router_watcher_t once = { 0 };
+	router_watcher_t *watcher;
+	char path[32];
+	const router_route_record_t *record;
 
 	router = router_create(NULL);
 	config = router_config_create();
@@ -502,6 +829,15 @@ void test_router_history(void)
 	router_config_destroy(config);
 
 	history = router_get_history(router);
+	router_back(router);
+	router_forward(router);
+	it_b("router.back() and router.forward() without entries, "
+	     "router.currentRoute",
+	     router_get_current_route(router) == NULL, TRUE);
+	it_i("router.back() and router.forward() without entries, "
+	     "router.history.index",
+	     (int)router_history_get_index(history), 0);
+
 	location = router_location_create(NULL, "/foo/bar");
 	router_push(router, location);
 	route = router_get_current_route(router);
@@ -591,9 +927,362 @@ void test_router_history(void)
 	it_s("router.forward(), router.currentRoute.path",
 	     router_route_get_path(route), "/foo");
 
+	location = router_location_create(NULL, "/bar?tab=info#top");
+	router_replace(router, location);
+	router_route_pool_get_stats(&route_stats);
+	router_location_pool_get_stats(&location_stats);
+	router_string_dict_pool_get_stats(&dict_stats);
+	for (i = 0; i < 10; ++i) {
+		router_replace(router, location);
+	}
+	router_route_pool_get_stats(&stats);
+	it_i("router.replace() x 10, routePool.misses",
+	     (int)(stats.misses - route_stats.misses), 0);
+	router_location_pool_get_stats(&stats);
+	it_i("router.replace() x 10, locationPool.misses",
+	     (int)(stats.misses - location_stats.misses), 0);
+	router_string_dict_pool_get_stats(&stats);
+	it_i("router.replace() x 10, stringDictPool.misses",
+	     (int)(stats.misses - dict_stats.misses), 0);
+	router_location_destroy(location);
+
+	router_history_set_max_materialized(history, 1);
+	location = router_location_create(NULL, "/foo/bar?tab=info");
+	router_push(router, location);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo");
+	router_push(router, location);
+	router_location_destroy(location);
+	entry = history->entries.head.next->next->data;
+	it_b("router.history.setMaxMaterialized(1), history[2] is compacted",
+	     !entry->route && entry->record, TRUE);
+	router_back(router);
+	route = router_get_current_route(router);
+	it_s("router.back(), router.currentRoute.fullPath",
+	     router_route_get_full_path(route), "/foo/bar?tab=info");
+	it_s("router.back(), router.currentRoute.matched[0].components.default",
+	     router_route_record_get_component(
+		 router_route_get_matched_record(route, 0), NULL),
+	     "foobar");
+	it_b("router.back() to a compacted entry, currentRoute.routesVersion",
+	     route->routes_version == router->routes_version, TRUE);
+
+	fp = tmpfile();
+	it_i("router.saveHistory()", router_save_history(router, fp), 0);
+	location = router_location_create(NULL, "/bar");
+	router_push(router, location);
+	router_location_destroy(location);
+	router_watch(router, test_router_history_on_change, &changes);
+	rewind(fp);
+	it_i("router.restoreHistory()", router_restore_history(router, fp), 0);
+	fclose(fp);
+	it_i("router.restoreHistory(), router.history.length",
+	     (int)router_history_get_length(history), 4);
+	it_i("router.restoreHistory(), router.history.index",
+	     (int)router_history_get_index(history), 2);
+	it_i("router.restoreHistory(), watcher calls", changes, 1);
+	route = router_get_current_route(router);
+	it_s("router.restoreHistory(), router.currentRoute.fullPath",
+	     router_route_get_full_path(route), "/foo/bar?tab=info");
+	router_forward(router);
+	route = router_get_current_route(router);
+	it_s("router.forward(), router.currentRoute.path",
+	     router_route_get_path(route), "/foo");
+
+	fp = tmpfile();
+	fputs("lcui-router-history 1\n3 1\n/foo\n", fp);
+	rewind(fp);
+	it_i("router.restoreHistory() with truncated file",
+	     router_restore_history(router, fp), -1);
+	fclose(fp);
+	it_i("router.restoreHistory() with truncated file, history.length",
+	     (int)router_history_get_length(history), 4);
+
+	location = router_location_create(NULL, "/bar");
+	router_push(router, location);
+	router_location_destroy(location);
+	record = router_get_matched_route_record(router, 0);
+	router_watch_path(router, "/foo/", test_router_history_on_change,
+			  &path_changes);
+	router_watch_record(router, record, test_router_history_on_change,
+			    &record_changes);
+	once.router = router;
+	once.watcher =
+	    router_watch(router, test_router_history_on_change_once, &once);
+	location = router_location_create(NULL, "/bar?tab=info");
+	router_push(router, location);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo/bar");
+	router_push(router, location);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo");
+	router_push(router, location);
+	router_location_destroy(location);
+	it_i("router.watchPath('/foo/'), watcher calls", path_changes, 2);
+	it_i("router.watchRecord(bar), watcher calls", record_changes, 2);
+	it_i("watcher removed while being called, watcher calls",
+	     once.changes, 1);
+	for (i = 0; i < 100; ++i) {
+		snprintf(path, sizeof(path), "/items/%d", i);
+		watcher = router_watch_path(router, path,
+					    test_router_history_on_change,
+					    &changes);
+		router_unwatch(router, watcher);
+	}
+	it_i("router.watchPath() and router.unwatch() x 100, only the "
+	     "'/foo' bucket is left",
+	     (int)Dict_Size(history->path_watchers), 1);
+
+	changes = 0;
+	i = (int)router_history_get_length(history);
+	router_begin_batch(router, TRUE);
+	location = router_location_create(NULL, "/bar");
+	router_push(router, location);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo/bar");
+	router_push(router, location);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo");
+	router_push(router, location);
+	router_location_destroy(location);
+	it_i("router.beginBatch(), router.push() x 3, watcher calls", changes,
+	     0);
+	router_commit(router);
+	it_i("router.commit(), watcher calls", changes, 1);
+	it_i("router.commit(), router.history.length",
+	     (int)router_history_get_length(history), i + 1);
+	it_s("router.commit(), router.currentRoute.path",
+	     router_route_get_path(router_get_current_route(router)), "/foo");
+
+	changes = 0;
+	i = (int)router_history_get_length(history);
+	route = router_get_current_route(router);
+	location = router_location_create(NULL, "/foo");
+	router_push(router, location);
+	it_i("router.push('/foo') on '/foo', watcher calls", changes, 0);
+	it_b("router.push('/foo') on '/foo', router.currentRoute is kept",
+	     router_get_current_route(router) == route, TRUE);
+	router_set_same_route_reload(router, TRUE);
+	router_push(router, location);
+	router_location_destroy(location);
+	it_i("router.push('/foo') on '/foo' with reload, watcher calls",
+	     changes, 1);
+	it_i("router.push('/foo') on '/foo', router.history.length",
+	     (int)router_history_get_length(history), i);
+
+	record = router_get_matched_route_record(router, 0);
+	location = router_location_create(NULL, "/foo?tab=info#top");
+	router_push(router, location);
+	router_location_destroy(location);
+	route = router_get_current_route(router);
+	it_b("router.push('/foo?tab=info#top') on '/foo', reuses the matched "
+	     "records",
+	     router_get_matched_route_record(router, 0) == record, TRUE);
+	it_s("router.push('/foo?tab=info#top') on '/foo', "
+	     "router.currentRoute.fullPath",
+	     router_route_get_full_path(route), "/foo?tab=info#top");
+
+	changes = 0;
+	router_set_navigation_loader(router, test_router_navigation_loader,
+				     navigations);
+	location = router_location_create(NULL, "/bar");
+	router_navigate(router, location, FALSE, test_router_on_navigation_done,
+			&first_status);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo/bar");
+	router_navigate(router, location, FALSE, test_router_on_navigation_done,
+			&second_status);
+	router_location_destroy(location);
+	it_b("router.navigate() x 2, the first navigation is cancelled",
+	     router_navigation_is_cancelled(navigations[0]), TRUE);
+	router_navigation_next(navigations[1], TRUE);
+	router_navigation_next(navigations[0], TRUE);
+	it_i("router.navigate(), watcher calls before commit", changes, 0);
+	LCUI_ProcessEvents();
+	it_i("router.navigate('/bar'), status", first_status,
+	     ROUTER_NAVIGATION_CANCELLED);
+	it_i("router.navigate('/foo/bar'), status", second_status,
+	     ROUTER_NAVIGATION_DONE);
+	it_i("router.navigate(), watcher calls", changes, 1);
+	it_s("router.navigate('/foo/bar'), router.currentRoute.path",
+	     router_route_get_path(router_get_current_route(router)),
+	     "/foo/bar");
+
+	navigations[0] = NULL;
+	location = router_location_create(NULL, "/bar");
+	router_navigate(router, location, FALSE, test_router_on_navigation_done,
+			&first_status);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo/bar");
+	router_replace(router, location);
+	router_location_destroy(location);
+	it_b("router.replace(), pending navigations are cancelled",
+	     router_navigation_is_cancelled(navigations[0]), TRUE);
+	router_navigation_next(navigations[0], TRUE);
+	LCUI_ProcessEvents();
+	it_i("router.navigate('/bar') before router.replace(), status",
+	     first_status, ROUTER_NAVIGATION_CANCELLED);
+	it_s("router.navigate('/bar') before router.replace(), "
+	     "router.currentRoute.path",
+	     router_route_get_path(router_get_current_route(router)),
+	     "/foo/bar");
+
+	navigations[0] = NULL;
+	location = router_location_create(NULL, "/bar");
+	router_navigate(router, location, FALSE, test_router_on_navigation_done,
+			&first_status);
+	router_location_destroy(location);
+	router_back(router);
+	route = router_get_current_route(router);
+	it_b("router.back(), pending navigations are cancelled",
+	     router_navigation_is_cancelled(navigations[0]), TRUE);
+	router_navigation_next(navigations[0], TRUE);
+	LCUI_ProcessEvents();
+	it_i("router.navigate('/bar') before router.back(), status",
+	     first_status, ROUTER_NAVIGATION_CANCELLED);
+	it_b("router.navigate('/bar') before router.back(), "
+	     "router.currentRoute is kept",
+	     router_get_current_route(router) == route, TRUE);
+	router_forward(router);
+
+	navigations[0] = NULL;
+	other = router_create("navigation");
+	router_set_navigation_loader(other, test_router_navigation_loader,
+				     navigations);
+	location = router_location_create(NULL, "/foo");
+	router_navigate(other, location, FALSE, test_router_on_navigation_done,
+			&second_status);
+	router_location_destroy(location);
+	router_destroy(other);
+	it_b("router.destroy(), pending navigations are cancelled",
+	     router_navigation_is_cancelled(navigations[0]), TRUE);
+	router_navigation_next(navigations[0], TRUE);
+	LCUI_ProcessEvents();
+	it_i("router.navigate() before router.destroy(), status",
+	     second_status, ROUTER_NAVIGATION_CANCELLED);
+
+	router_set_navigation_loader(router, NULL, NULL);
+	record = router_get_matched_route_record(router, 0);
+	router_route_record_before_leave((router_route_record_t *)record,
+					 test_router_guard, &leave_guard);
+	location = router_location_create(NULL, "/bar");
+	route = router_match(router, location, NULL);
+	router_route_record_before_enter(
+	    (router_route_record_t *)router_route_get_matched_record(route, 0),
+	    test_router_guard, &enter_guard);
+	router_route_unref((router_route_t *)route);
+	router_before_each(router, test_router_guard, &global_guard);
+	router_push(router, location);
+	it_i("router.push('/bar'), beforeLeave guard calls", leave_guard.calls,
+	     1);
+	it_i("router.push('/bar'), beforeEach guard calls after beforeLeave "
+	     "aborted",
+	     global_guard.calls, 0);
+	it_s("router.push('/bar'), aborted by the beforeLeave guard",
+	     router_route_get_path(router_get_current_route(router)),
+	     "/foo/bar");
+	leave_guard.result = ROUTER_GUARD_NEXT;
+	router_push(router, location);
+	router_location_destroy(location);
+	it_i("router.push('/bar'), beforeEnter guard calls", enter_guard.calls,
+	     1);
+	it_s("router.push('/bar'), redirected by the beforeEnter guard",
+	     router_route_get_path(router_get_current_route(router)), "/foo");
+	i = global_guard.calls;
+	router_back(router);
+	it_i("router.back(), beforeEach guard calls", global_guard.calls - i,
+	     1);
+	it_s("router.back(), router.currentRoute.path",
+	     router_route_get_path(router_get_current_route(router)),
+	     "/foo/bar");
+	leave_guard.calls = 0;
+	leave_guard.result = ROUTER_GUARD_ABORT;
+	router_forward(router);
+	it_i("router.forward(), beforeLeave guard calls", leave_guard.calls,
+	     1);
+	it_s("router.forward(), aborted by the beforeLeave guard",
+	     router_route_get_path(router_get_current_route(router)),
+	     "/foo/bar");
+	leave_guard.result = ROUTER_GUARD_NEXT;
+	router_forward(router);
+	it_s("router.forward(), router.currentRoute.path",
+	     router_route_get_path(router_get_current_route(router)), "/foo");
+
+	changes = 0;
+	i = (int)router_history_get_length(history);
+	LCUIThread_Create(&thread, test_router_push_worker, router);
+	LCUIThread_Join(thread, NULL);
+	it_i("router.pushAsync() x 3, watcher calls before drain", changes, 0);
+	LCUI_ProcessEvents();
+	it_i("router.pushAsync() x 3, watcher calls", changes, 1);
+	it_i("router.pushAsync() x 3, router.history.length",
+	     (int)router_history_get_length(history), i + 1);
+	it_s("router.pushAsync() x 3, router.currentRoute.fullPath",
+	     router_route_get_full_path(router_get_current_route(router)),
+	     "/foo/bar?tab=2");
+
+	config = router_config_create();
+	router_config_set_path(config, "/users/:id");
+	router_config_add_alias(config, "/u/:id");
+	router_config_set_component(config, NULL, "user");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+	location = router_location_create(NULL, "/u/7");
+	router_push(router, location);
+	router_location_destroy(location);
+	location = router_location_create(NULL, "/foo");
+	router_push(router, location);
+	router_location_destroy(location);
+	entry = LinkedList_Get(&history->entries, history->index - 1);
+	it_b("router.push('/foo'), the '/u/7' alias entry is compacted",
+	     !entry->route, TRUE);
+	router_back(router);
+	route = router_get_current_route(router);
+	it_s("router.back() to a compacted alias entry, "
+	     "router.currentRoute.params.id",
+	     router_route_get_param(route, "id"), "7");
+
+	location = router_location_create(NULL, "/foo/bar?note=a%\nb");
+	router_push(router, location);
+	router_location_destroy(location);
+	i = (int)router_history_get_length(history);
+	fp = tmpfile();
+	router_save_history(router, fp);
+	location = router_location_create(NULL, "/foo");
+	router_push(router, location);
+	router_location_destroy(location);
+	rewind(fp);
+	it_i("router.restoreHistory() with a newline in a query value",
+	     router_restore_history(router, fp), 0);
+	fclose(fp);
+	it_i("router.restoreHistory() with a newline in a query value, "
+	     "router.history.length",
+	     (int)router_history_get_length(history), i);
+	it_s("router.restoreHistory() with a newline in a query value, "
+	     "router.currentRoute.fullPath",
+	     router_route_get_full_path(router_get_current_route(router)),
+	     "/foo/bar?note=a%\nb");
+	router_back(router);
+	it_s("router.back(), router.currentRoute.params.id",
+	     router_route_get_param(router_get_current_route(router), "id"),
+	     "7");
+
 	router_destroy(router);
 }
 
+static void test_router_on_route_update(LCUI_Widget w, LCUI_WidgetEvent e,
+					void *arg)
+{
+	int *count = e->data;
+
+	(*count)++;
+}
+
+static void test_router_reset_widget(LCUI_Widget w)
+{
+	Widget_SetAttribute(w, "reset", "reset");
+}
+
 void test_router_components(void)
 {
 	router_t *router;
@@ -602,9 +1291,22 @@ void test_router_components(void)
 	LCUI_Widget link_foo;
 	LCUI_Widget link_foobar;
 	LCUI_Widget link_bar;
+	LCUI_Widget link_idle;
+	LCUI_Widget link_old;
 	LCUI_Widget view;
+	LCUI_Widget bfcache_view;
+	LCUI_Widget keep_alive_view;
 	LCUI_Widget matched_widget;
+	LCUI_Widget bar_widget;
+	LCUI_Widget pooled_widget;
+	LCUI_Widget foobar_widget;
 	LCUI_WidgetEventRec e;
+	RouterLink link;
+	router_location_t *location;
+	const router_route_t *resolved_route;
+	RouterViewCacheStatsRec stats;
+	int route_updates = 0;
+	int i;
 
 	router = router_create(NULL);
 	config = router_config_create();
@@ -631,6 +1333,7 @@ void test_router_components(void)
 	LCUIWidget_NewPrototype("bar", NULL);
 	UI_InitRouterLink();
 	UI_InitRouterView();
+	RouterView_EnablePool("bar", 1, test_router_reset_widget);
 	root = LCUIWidget_GetRoot();
 	view = LCUIWidget_New("router-view");
 	link_foo = LCUIWidget_New("router-link");
@@ -639,10 +1342,17 @@ void test_router_components(void)
 	Widget_SetAttribute(link_foo, "to", "/foo");
 	Widget_SetAttribute(link_foobar, "to", "/foo/bar");
 	Widget_SetAttribute(link_bar, "to", "/bar");
+	bfcache_view = LCUIWidget_New("router-view");
+	Widget_SetAttribute(bfcache_view, "bfcache", "2");
+	keep_alive_view = LCUIWidget_New("router-view");
+	Widget_SetAttribute(keep_alive_view, "keep-alive", "keep-alive");
+	Widget_SetAttribute(keep_alive_view, "max", "1");
 	Widget_Append(root, link_foo);
 	Widget_Append(root, link_foobar);
 	Widget_Append(root, link_bar);
 	Widget_Append(root, view);
+	Widget_Append(root, bfcache_view);
+	Widget_Append(root, keep_alive_view);
 	LCUIWidget_Update();
 
 	LCUI_InitWidgetEvent(&e, "click");
@@ -656,8 +1366,14 @@ void test_router_components(void)
 	     TRUE);
 	Widget_TriggerEvent(link_bar, &e, NULL);
 	matched_widget = RouterView_GetMatchedWidget(view);
+	bar_widget = RouterView_GetMatchedWidget(bfcache_view);
+	pooled_widget = matched_widget;
 	it_b("[/bar] <router-view> widget should load <bar> widget",
 	     strcmp(matched_widget->type, "bar") == 0, TRUE);
+	it_b("[/bar] <router-view> should only contain the <bar> widget",
+	     view->children.length == 1 &&
+		 view->children.head.next->data == matched_widget,
+	     TRUE);
 	it_b("[/bar] linkFoo should not has active classes",
 	     (!Widget_HasClass(link_foo, "router-link-exact-active") &&
 	      !Widget_HasClass(link_foo, "router-link-active")),
@@ -665,6 +1381,7 @@ void test_router_components(void)
 
 	Widget_TriggerEvent(link_foobar, &e, NULL);
 	matched_widget = RouterView_GetMatchedWidget(view);
+	foobar_widget = RouterView_GetMatchedWidget(bfcache_view);
 	it_b("[/foo/bar] <router-view> widget should load <foobar> widget",
 	     strcmp(matched_widget->type, "foobar") == 0, TRUE);
 	it_b("[/foo/bar] linkFooBar should has active classes",
@@ -675,13 +1392,165 @@ void test_router_components(void)
 	     (!Widget_HasClass(link_foo, "router-link-exact-active") &&
 	      Widget_HasClass(link_foo, "router-link-active")),
 	     TRUE);
+	Widget_BindEvent(matched_widget, "routeupdate",
+			 test_router_on_route_update, &route_updates, NULL);
 	Widget_SetAttribute(link_foo, "exact", "exact");
+	router_set_same_route_reload(router, TRUE);
 	Widget_TriggerEvent(link_foobar, &e, NULL);
+	router_set_same_route_reload(router, FALSE);
 	it_b("[/foo/bar] linkFoo should not has any active classes (exact)",
 	     (!Widget_HasClass(link_foo, "router-link-exact-active") &&
 	      !Widget_HasClass(link_foo, "router-link-active")),
 	     TRUE);
+	it_b("[/foo/bar] router.push('/foo/bar'), <router-view> should keep "
+	     "the <foobar> widget",
+	     RouterView_GetMatchedWidget(view) == matched_widget, TRUE);
+	it_i("[/foo/bar] router.push('/foo/bar'), <foobar> should receive "
+	     "a routeupdate event",
+	     route_updates, 1);
+
+	Widget_TriggerEvent(link_foo, &e, NULL);
+	router_back(router);
+	it_b("[/foo/bar] router.back(), <router-view bfcache> should restore "
+	     "the cached <foobar> widget",
+	     RouterView_GetMatchedWidget(bfcache_view) == foobar_widget, TRUE);
+	router_back(router);
+	it_b("[/bar] router.back(), <router-view bfcache> should restore the "
+	     "cached <bar> widget",
+	     RouterView_GetMatchedWidget(bfcache_view) == bar_widget, TRUE);
+	it_b("[/bar] router.back(), <router-view> should reuse the released "
+	     "<bar> widget from the pool",
+	     RouterView_GetMatchedWidget(view) == pooled_widget, TRUE);
+	it_b("[/bar] router.back(), the pooled <bar> widget should be reset",
+	     Widget_GetAttribute(pooled_widget, "reset") != NULL, TRUE);
+	router_back(router);
+	matched_widget = RouterView_GetMatchedWidget(bfcache_view);
+	it_b("[/foo] router.back(), <router-view bfcache> should load a new "
+	     "<foo> widget after the cached one is evicted",
+	     strcmp(matched_widget->type, "foo") == 0, TRUE);
+
+	RouterView_GetKeepAliveStats(keep_alive_view, &stats);
+	it_i("<router-view keep-alive max=\"1\">, cache.hits", (int)stats.hits,
+	     1);
+	it_i("<router-view keep-alive max=\"1\">, cache.evictions",
+	     (int)stats.evictions, 4);
+	it_i("<router-view keep-alive max=\"1\">, cache.length",
+	     (int)stats.length, 1);
+
+	Widget_SetAttribute(link_foobar, "prefetch", "hover");
+	LCUI_InitWidgetEvent(&e, "mouseover");
+	Widget_TriggerEvent(link_foobar, &e, NULL);
+	LCUI_ProcessEvents();
+	RouterView_GetPrefetchStats(&stats);
+	it_i("[/foo] linkFooBar:hover, <foobar> should be prefetched",
+	     (int)stats.length, 1);
+	LCUI_InitWidgetEvent(&e, "click");
+	Widget_TriggerEvent(link_foobar, &e, NULL);
+	RouterView_GetPrefetchStats(&stats);
+	it_i("[/foo/bar] <router-view> should use the prefetched <foobar>",
+	     (int)stats.hits, 1);
+
+	RouterView_SetDeferredDestroy(TRUE, 4);
+	Widget_TriggerEvent(link_bar, &e, NULL);
+	it_i("[/bar] evicted widgets should be queued for deferred destruction",
+	     (int)RouterView_FlushDestroyQueue(), 2);
+	RouterView_SetDeferredDestroy(FALSE, 0);
+
+	link = Widget_GetData(link_bar, router_link_proto);
+	resolved_route = link->resolved;
+	Widget_TriggerEvent(link_foo, &e, NULL);
+	it_b("[/foo] linkBar should reuse its resolved route",
+	     link->resolved == resolved_route, TRUE);
+	config = router_config_create();
+	router_config_set_path(config, "/baz");
+	router_config_set_component(config, NULL, "bar");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+	Widget_TriggerEvent(link_bar, &e, NULL);
+	it_b("[/bar] linkBar should resolve its route again after the route "
+	     "table changed",
+	     link->routes_version == router->routes_version, TRUE);
+	link = Widget_GetData(link_foobar, router_link_proto);
+	it_b("[/bar] linkFooBar should be indexed again after the route table "
+	     "changed",
+	     link->stamp == link->index->stamp, TRUE);
+	Widget_TriggerEvent(link_foo, &e, NULL);
+	Widget_TriggerEvent(link_bar, &e, NULL);
+	it_b("[/bar] linkFooBar should not be visited by the link index",
+	     link->stamp != link->index->stamp, TRUE);
+	link = Widget_GetData(link_foo, router_link_proto);
+	it_b("[/bar] linkFoo should be visited by the link index because it "
+	     "was active",
+	     link->stamp == link->index->stamp && !link->active, TRUE);
+
+	matched_widget = RouterView_GetMatchedWidget(keep_alive_view);
+	RouterView_GetKeepAliveStats(keep_alive_view, &stats);
+	i = (int)stats.hits;
+	Widget_TriggerEvent(link_foo, &e, NULL);
+	Widget_TriggerEvent(link_bar, &e, NULL);
+	RouterView_GetKeepAliveStats(keep_alive_view, &stats);
+	it_b("[/bar] <router-view keep-alive max=\"1\"> should show the "
+	     "cached <bar> widget instead of evicting it",
+	     RouterView_GetMatchedWidget(keep_alive_view) == matched_widget,
+	     TRUE);
+	it_i("[/foo] -> [/bar], <router-view keep-alive max=\"1\"> should hit "
+	     "the cache twice",
+	     (int)stats.hits - i, 2);
+	it_i("[/bar] <router-view keep-alive max=\"1\">, cache.length",
+	     (int)stats.length, 1);
+
+	route_updates = 0;
+	i = (int)stats.evictions;
+	Widget_BindEvent(matched_widget, "routeupdate",
+			 test_router_on_route_update, &route_updates, NULL);
+	location = router_location_create(NULL, "/bar?tab=1");
+	router_push(router, location);
+	router_location_destroy(location);
+	RouterView_GetKeepAliveStats(keep_alive_view, &stats);
+	it_b("[/bar?tab=1] <router-view keep-alive max=\"1\"> should keep the "
+	     "<bar> widget",
+	     RouterView_GetMatchedWidget(keep_alive_view) == matched_widget,
+	     TRUE);
+	it_i("[/bar?tab=1] <bar> should receive a routeupdate event",
+	     route_updates, 1);
+	it_i("[/bar?tab=1] <router-view keep-alive max=\"1\"> should not "
+	     "evict anything",
+	     (int)stats.evictions - i, 0);
+
+	RouterView_GetPrefetchStats(&stats);
+	i = (int)stats.length;
+	link_idle = LCUIWidget_New("router-link");
+	Widget_SetAttribute(link_idle, "to", "/foo");
+	Widget_SetAttribute(link_idle, "prefetch", "idle");
+	Widget_Append(root, link_idle);
+	LCUIWidget_Update();
+	RouterView_GetPrefetchStats(&stats);
+	it_i("<router-link prefetch=\"idle\"> should not prefetch when it is "
+	     "ready",
+	     (int)stats.length - i, 0);
+	LCUI_ProcessTimers();
+	LCUI_ProcessEvents();
+	RouterView_GetPrefetchStats(&stats);
+	it_i("<router-link prefetch=\"idle\"> should prefetch <foo> once the "
+	     "UI is idle",
+	     (int)stats.length - i, 1);
+
+	link_old = LCUIWidget_New("router-link");
+	Widget_SetAttribute(link_old, "to", "/old");
+	Widget_Append(root, link_old);
+	LCUIWidget_Update();
+	config = router_config_create();
+	router_config_set_path(config, "/old");
+	router_config_set_redirect(config, "/bar");
+	router_add_route_record(router, config, NULL);
+	router_config_destroy(config);
+	Widget_TriggerEvent(link_foo, &e, NULL);
+	Widget_TriggerEvent(link_bar, &e, NULL);
+	it_b("[/bar] linkOld should be active after '/old' was redirected to "
+	     "'/bar'",
+	     Widget_HasClass(link_old, "router-link-active"), TRUE);
 
+	RouterView_ClearPools();
 	LCUI_Destroy();
 	router_destroy(router);
 }